@@ -0,0 +1,336 @@
+/*
+ *      batchencryptiondialog.cpp
+ *
+ *      Copyright 2008 gpg4usb-team <gpg4usb@cpunk.de>
+ *
+ *      This file is part of gpg4usb.
+ *
+ *      Gpg4usb is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      Gpg4usb is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with gpg4usb.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "batchencryptiondialog.h"
+
+BatchEncryptionDialog::BatchEncryptionDialog(GpgME::GpgContext *ctx, QStringList keyList, QStringList files, QWidget *parent,
+                                             bool decrypt)
+        : QDialog(parent)
+{
+    mCtx = ctx;
+    mBatch = 0;
+    setWindowTitle(tr("Batch File Encryption"));
+    resize(600, 550);
+    setModal(true);
+    setAcceptDrops(true);
+
+    /* Setup file list */
+    QGroupBox *filesGroupBox = new QGroupBox(tr("Files"));
+    fileList = new QTreeWidget();
+    fileList->setColumnCount(2);
+    fileList->setHeaderLabels(QStringList() << tr("File") << tr("Result"));
+    fileList->setRootIsDecorated(false);
+    fileList->header()->setResizeMode(0, QHeaderView::Stretch);
+    fileList->header()->setStretchLastSection(false);
+
+    QPushButton *addDirButton = new QPushButton(tr("Add &Directory..."));
+    connect(addDirButton, SIGNAL(clicked()), this, SLOT(slotAddDirectory()));
+    QPushButton *addFilesButton = new QPushButton(tr("Add &Files..."));
+    connect(addFilesButton, SIGNAL(clicked()), this, SLOT(slotAddFiles()));
+    QPushButton *clearButton = new QPushButton(tr("C&lear"));
+    connect(clearButton, SIGNAL(clicked()), this, SLOT(slotClearFiles()));
+
+    inputButtons = new QWidget();
+    QHBoxLayout *buttonsLayout = new QHBoxLayout();
+    buttonsLayout->setContentsMargins(0, 0, 0, 0);
+    buttonsLayout->addWidget(addDirButton);
+    buttonsLayout->addWidget(addFilesButton);
+    buttonsLayout->addWidget(clearButton);
+    buttonsLayout->addStretch(1);
+    inputButtons->setLayout(buttonsLayout);
+
+    QVBoxLayout *filesLayout = new QVBoxLayout();
+    filesLayout->addWidget(fileList);
+    filesLayout->addWidget(inputButtons);
+    filesGroupBox->setLayout(filesLayout);
+
+    /* Setup Action */
+    QGroupBox *actionGroupBox = new QGroupBox(tr("Action"));
+    radioEnc = new QRadioButton(tr("&Encrypt"));
+    connect(radioEnc, SIGNAL(clicked()), this, SLOT(slotShowKeyList()));
+    radioDec = new QRadioButton(tr("D&ecrypt"));
+    connect(radioDec, SIGNAL(clicked()), this, SLOT(slotHideKeyList()));
+    radioEnc->setChecked(true);
+
+    QHBoxLayout *actionLayout = new QHBoxLayout();
+    actionLayout->addWidget(radioEnc);
+    actionLayout->addWidget(radioDec);
+    actionGroupBox->setLayout(actionLayout);
+
+    /*Setup KeyList*/
+    mKeyList = new KeyList(mCtx);
+    mKeyList->setColumnWidth(2, 150);
+    mKeyList->setColumnWidth(3, 150);
+    mKeyList->setChecked(&keyList);
+
+    armorCheckBox = new QCheckBox(tr("ASCII armored output (.asc)"));
+
+    /* Setup progress */
+    progressBar = new QProgressBar();
+    progressBar->setValue(0);
+    statusLabel = new QLabel();
+
+    buttonBox = new QDialogButtonBox(QDialogButtonBox::Close);
+    startButton = buttonBox->addButton(tr("&Start"), QDialogButtonBox::AcceptRole);
+    connect(buttonBox, SIGNAL(accepted()), this, SLOT(slotExecuteAction()));
+    connect(buttonBox, SIGNAL(rejected()), this, SLOT(reject()));
+
+    QVBoxLayout *vbox = new QVBoxLayout();
+    vbox->addWidget(actionGroupBox);
+    vbox->addWidget(filesGroupBox);
+    vbox->addWidget(mKeyList);
+    vbox->addWidget(armorCheckBox);
+    vbox->addWidget(progressBar);
+    vbox->addWidget(statusLabel);
+    vbox->addWidget(buttonBox);
+    setLayout(vbox);
+
+    foreach (QString path, files) {
+        addPath(path);
+    }
+    if (decrypt) {
+        radioDec->setChecked(true);
+        slotHideKeyList();
+    }
+}
+
+void BatchEncryptionDialog::slotAddDirectory()
+{
+    QString dir = QFileDialog::getExistingDirectory(this, tr("Add Directory"));
+    if (!dir.isEmpty()) {
+        addPath(dir);
+    }
+}
+
+void BatchEncryptionDialog::slotAddFiles()
+{
+    foreach (QString fileName, QFileDialog::getOpenFileNames(this, tr("Add Files"))) {
+        addPath(fileName);
+    }
+}
+
+void BatchEncryptionDialog::slotClearFiles()
+{
+    fileList->clear();
+    progressBar->setValue(0);
+    statusLabel->clear();
+}
+
+void BatchEncryptionDialog::addPath(const QString &path)
+{
+    QFileInfo info(path);
+    if (info.isDir()) {
+        QDirIterator it(path, QDir::Files | QDir::Hidden, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            QString fileName = it.next();
+            // skip the output of an earlier run next to its input, a .gpg
+            // or .asc file without its plain file is added for decryption
+            if ((fileName.endsWith(".gpg") || fileName.endsWith(".asc"))
+                    && QFileInfo(fileName.left(fileName.size() - 4)).isFile()) {
+                continue;
+            }
+            new QTreeWidgetItem(fileList, QStringList() << fileName);
+        }
+    } else if (info.isFile()) {
+        new QTreeWidgetItem(fileList, QStringList() << path);
+    }
+}
+
+void BatchEncryptionDialog::dragEnterEvent(QDragEnterEvent *event)
+{
+    if (event->mimeData()->hasUrls() && !mBatch) {
+        event->acceptProposedAction();
+    }
+}
+
+void BatchEncryptionDialog::dropEvent(QDropEvent *event)
+{
+    foreach (QUrl url, event->mimeData()->urls()) {
+        addPath(url.toLocalFile());
+    }
+    event->acceptProposedAction();
+}
+
+/** Output is written next to the input, like in the file encryption dialog
+ */
+QString BatchEncryptionDialog::outputFileName(const QString &inFileName) const
+{
+    if (radioEnc->isChecked()) {
+        return inFileName + (armorCheckBox->isChecked() ? ".asc" : ".gpg");
+    }
+    if (inFileName.endsWith(".asc", Qt::CaseInsensitive)
+            || inFileName.endsWith(".gpg", Qt::CaseInsensitive)
+            || inFileName.endsWith(".pgp", Qt::CaseInsensitive)) {
+        QString ofn = inFileName;
+        ofn.chop(4);
+        return ofn;
+    }
+    return inFileName + ".out";
+}
+
+void BatchEncryptionDialog::slotExecuteAction()
+{
+    int count = fileList->topLevelItemCount();
+    if (count == 0 || mBatch) {
+        return;
+    }
+
+    QStringList uidList = *mKeyList->getChecked();
+    if (radioEnc->isChecked() && uidList.isEmpty()) {
+        QMessageBox::critical(this, tr("No Key Selected"), tr("No Key Selected"));
+        return;
+    }
+
+    int existing = 0;
+    for (int i = 0; i < count; i++) {
+        if (QFile::exists(outputFileName(fileList->topLevelItem(i)->text(0)))) {
+            existing++;
+        }
+    }
+    if (existing > 0) {
+        QMessageBox::StandardButton ret;
+        ret = QMessageBox::warning(this, tr("File"),
+                                   tr("%1 output files exist! Do you want to overwrite them?").arg(existing),
+                                   QMessageBox::Ok|QMessageBox::Cancel);
+        if (ret == QMessageBox::Cancel) {
+            return;
+        }
+    }
+
+    if (radioEnc->isChecked()) {
+        mBatch = new GpgME::GpgBatch(mCtx, GpgME::GpgJob::EncryptFile, this);
+        mBatch->setKeys(uidList);
+        mBatch->setArmor(armorCheckBox->isChecked());
+    } else {
+        mBatch = new GpgME::GpgBatch(mCtx, GpgME::GpgJob::DecryptFile, this);
+    }
+    for (int i = 0; i < count; i++) {
+        QTreeWidgetItem *item = fileList->topLevelItem(i);
+        item->setText(1, "");
+        mBatch->addFile(item->text(0), outputFileName(item->text(0)));
+    }
+    connect(mBatch, SIGNAL(signalFileFinished(int, bool, const QString &)),
+            this, SLOT(slotFileFinished(int, bool, const QString &)));
+    connect(mBatch, SIGNAL(signalFinished()), this, SLOT(slotBatchFinished()));
+    connect(mBatch, SIGNAL(signalProgress()), this, SLOT(slotBatchProgress()));
+
+    progressBar->setRange(0, count);
+    progressBar->setValue(0);
+    startButton->setEnabled(false);
+    inputButtons->setEnabled(false);
+    radioEnc->setEnabled(false);
+    radioDec->setEnabled(false);
+
+    mBatch->start();
+    updateProgress();
+}
+
+void BatchEncryptionDialog::slotFileFinished(int index, bool success, const QString &errorString)
+{
+    QTreeWidgetItem *item = fileList->topLevelItem(index);
+    if (success) {
+        item->setText(1, tr("Done"));
+    } else {
+        item->setText(1, errorString.isEmpty() ? tr("Failed") : errorString.simplified());
+        item->setForeground(1, Qt::red);
+    }
+    updateProgress();
+}
+
+void BatchEncryptionDialog::slotBatchProgress()
+{
+    // reports of running files come often, a few updates per second are enough
+    if (mProgressTime.isValid() && mProgressTime.elapsed() < 200) {
+        return;
+    }
+    updateProgress();
+}
+
+void BatchEncryptionDialog::updateProgress()
+{
+    mProgressTime.start();
+    progressBar->setValue(mBatch->finishedCount());
+    statusLabel->setText(tr("%1 of %2 files, %3 failed, %4")
+                         .arg(mBatch->finishedCount())
+                         .arg(mBatch->count())
+                         .arg(mBatch->failedCount())
+                         .arg(GpgME::GpgContext::progressText(mBatch->bytesProcessed(),
+                                                              mBatch->bytesTotal(),
+                                                              mBatch->elapsed())));
+
+    // mirror the progress in the status bar of the main window
+    if (parentWidget()) {
+        QStatusTipEvent tip(statusLabel->text());
+        QApplication::sendEvent(parentWidget(), &tip);
+    }
+}
+
+void BatchEncryptionDialog::slotBatchFinished()
+{
+    updateProgress();
+    for (int i = mBatch->finishedCount(); i < fileList->topLevelItemCount(); i++) {
+        QTreeWidgetItem *item = fileList->topLevelItem(i);
+        if (item->text(1).isEmpty()) {
+            item->setText(1, tr("Canceled"));
+        }
+    }
+
+    int finished = mBatch->finishedCount();
+    int failed = mBatch->failedCount();
+    mBatch->deleteLater();
+    mBatch = 0;
+
+    startButton->setEnabled(true);
+    inputButtons->setEnabled(true);
+    radioEnc->setEnabled(true);
+    radioDec->setEnabled(true);
+
+    if (failed > 0) {
+        QMessageBox::warning(this, tr("Batch File Encryption"),
+                             tr("%1 of %2 files failed, see the file list for details.").arg(failed).arg(finished));
+    } else {
+        QMessageBox::information(this, tr("Done"), tr("%1 files processed.").arg(finished));
+    }
+}
+
+/** Closing while a batch runs cancels it, the files in progress are aborted
+ */
+void BatchEncryptionDialog::reject()
+{
+    if (mBatch) {
+        mBatch->cancel();
+        statusLabel->setText(tr("Canceling..."));
+        return;
+    }
+    QDialog::reject();
+}
+
+void BatchEncryptionDialog::slotShowKeyList()
+{
+    mKeyList->show();
+    armorCheckBox->show();
+}
+
+void BatchEncryptionDialog::slotHideKeyList()
+{
+    mKeyList->hide();
+    armorCheckBox->hide();
+}
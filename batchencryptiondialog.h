@@ -0,0 +1,105 @@
+/*
+ *      batchencryptiondialog.h
+ *
+ *      Copyright 2008 gpg4usb-team <gpg4usb@cpunk.de>
+ *
+ *      This file is part of gpg4usb.
+ *
+ *      Gpg4usb is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      Gpg4usb is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with gpg4usb.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef __BATCHENCRYPTIONDIALOG_H__
+#define __BATCHENCRYPTIONDIALOG_H__
+
+#include "gpgcontext.h"
+#include "gpgbatch.h"
+#include "keylist.h"
+
+QT_BEGIN_NAMESPACE
+class QDialog;
+class QWidget;
+class QDialogButtonBox;
+class QLabel;
+class QPushButton;
+class QRadioButton;
+class QCheckBox;
+class QProgressBar;
+class QTreeWidget;
+QT_END_NAMESPACE
+
+/**
+ * @brief Encrypt or decrypt many files at once
+ *
+ * @details Files are added from a directory, with a file dialog or by dropping
+ * them on the dialog. They are processed in parallel by a GpgBatch, the file
+ * list shows the result for every file when done. The caller shows the
+ * dialog with exec().
+ */
+class BatchEncryptionDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @param ctx
+     * @param keyList Keys checked for encryption
+     * @param files Files or directories to start with
+     * @param parent
+     * @param decrypt Start with decryption selected instead of encryption
+     */
+    BatchEncryptionDialog(GpgME::GpgContext *ctx, QStringList keyList, QStringList files = QStringList(),
+                          QWidget *parent = 0, bool decrypt = false);
+
+public slots:
+    void slotAddDirectory();
+    void slotAddFiles();
+    void slotClearFiles();
+    void slotExecuteAction();
+    void slotShowKeyList();
+    void slotHideKeyList();
+
+protected:
+    void dragEnterEvent(QDragEnterEvent *event);
+    void dropEvent(QDropEvent *event);
+    void reject();
+
+private slots:
+    void slotFileFinished(int index, bool success, const QString &errorString);
+    void slotBatchFinished();
+    void slotBatchProgress();
+
+private:
+    /**
+     * @details Add file or all files below the directory path.
+     */
+    void addPath(const QString &path);
+    QString outputFileName(const QString &inFileName) const;
+    void updateProgress();
+
+    GpgME::GpgContext *mCtx;
+    GpgME::GpgBatch *mBatch; /** the running batch, 0 if none */
+    KeyList *mKeyList;
+    QTreeWidget *fileList; /** input files and their result */
+    QRadioButton *radioEnc;
+    QRadioButton *radioDec;
+    QCheckBox *armorCheckBox; /** ascii armored instead of binary output for encryption */
+    QProgressBar *progressBar;
+    QLabel *statusLabel; /** files done and throughput */
+    QTime mProgressTime; /** last update of statusLabel */
+    QDialogButtonBox *buttonBox;
+    QPushButton *startButton;
+    QWidget *inputButtons; /** add and clear buttons, disabled while running */
+};
+
+#endif // __BATCHENCRYPTIONDIALOG_H__
@@ -38,8 +38,10 @@ FileEncryptionDialog::FileEncryptionDialog(GpgME::GpgContext *ctx, QStringList k
     }
 
     setModal(true);
+    mProgress = 0;
+    mJob = 0;
 
-    QDialogButtonBox *buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
     connect(buttonBox, SIGNAL(accepted()), this, SLOT(slotExecuteAction()));
     connect(buttonBox, SIGNAL(rejected()), this, SLOT(reject()));
 
@@ -74,6 +76,16 @@ FileEncryptionDialog::FileEncryptionDialog(GpgME::GpgContext *ctx, QStringList k
     mKeyList->setColumnWidth(3, 150);
     mKeyList->setChecked(&keyList);
 
+    // binary output is a third smaller than ascii armor
+    armorCheckBox = new QCheckBox(tr("ASCII armored output (.asc)"));
+    armorCheckBox->setToolTip(tr("Write text instead of binary output, e.g. for pasting the file into a mail"));
+    armorCheckBox->hide();
+    connect(armorCheckBox, SIGNAL(toggled(bool)), this, SLOT(slotArmorChanged()));
+
+    signCheckBox = new QCheckBox(tr("Sign with the checked private keys"));
+    signCheckBox->setToolTip(tr("Sign the file in the same step as encrypting it"));
+    signCheckBox->hide();
+
     /* Setup Action */
     radioEnc = new QRadioButton(tr("&Encrypt"));
     connect(radioEnc, SIGNAL(clicked()), this, SLOT(slotShowKeyList()));
@@ -94,6 +106,8 @@ FileEncryptionDialog::FileEncryptionDialog(GpgME::GpgContext *ctx, QStringList k
     }
     vbox2->addWidget(groupBox1);
     vbox2->addWidget(mKeyList);
+    vbox2->addWidget(armorCheckBox);
+    vbox2->addWidget(signCheckBox);
     vbox2->addWidget(buttonBox);
     vbox2->addStretch(0);
     setLayout(vbox2);
@@ -119,9 +133,11 @@ void FileEncryptionDialog::slotSelectInputFile()
     // try to find a matching output-filename, if not yet done
     if (infileName > 0 && outputFileEdit->text().size() == 0) {
         if (mAction == Encrypt || (mAction == Both && radioEnc->isChecked())) {
-            outputFileEdit->setText(infileName + ".asc");
+            outputFileEdit->setText(infileName + encryptedSuffix());
         } else {
-            if (infileName.endsWith(".asc", Qt::CaseInsensitive)) {
+            if (infileName.endsWith(".asc", Qt::CaseInsensitive)
+                    || infileName.endsWith(".gpg", Qt::CaseInsensitive)
+                    || infileName.endsWith(".pgp", Qt::CaseInsensitive)) {
                 QString ofn = infileName;
                 ofn.chop(4);
                 outputFileEdit->setText(ofn);
@@ -146,22 +162,13 @@ void FileEncryptionDialog::slotSelectOutputFile()
 
 void FileEncryptionDialog::slotExecuteAction()
 {
-
-    QFile infile;
-    infile.setFileName(inputFileEdit->text());
-    if (!infile.open(QIODevice::ReadOnly)) {
-        qDebug() << tr("Couldn't Open file: ") + inputFileEdit->text();
-    }
-
-    QByteArray inBuffer = infile.readAll();
-    QByteArray *outBuffer = new QByteArray();
-    infile.close();
-    if ( mAction == Encrypt || (mAction == Both && radioEnc->isChecked())) {
-        if (! mCtx->encrypt(mKeyList->getChecked(), inBuffer, outBuffer)) return;
+    // the progress dialog shows up late, until then the dialog takes input
+    if (mJob) {
+        return;
     }
-
-    if (mAction == Decrypt || (mAction == Both && radioDec->isChecked()))  {
-        if (! mCtx->decrypt(inBuffer, outBuffer)) return;
+    if (!QFile::exists(inputFileEdit->text())) {
+        qDebug() << tr("Couldn't Open file: ") + inputFileEdit->text();
+        return;
     }
 
     QFile outfile(outputFileEdit->text());
@@ -175,28 +182,109 @@ void FileEncryptionDialog::slotExecuteAction()
         }
     }
 
-    if (!outfile.open(QFile::WriteOnly)) {
-        QMessageBox::warning(this, tr("File"),
-                             tr("Cannot write file %1:\n%2.")
-                             .arg(outputFileEdit->text())
-                             .arg(outfile.errorString()));
+    GpgME::GpgJob *job;
+    if ( mAction == Encrypt || (mAction == Both && radioEnc->isChecked())) {
+        if (signCheckBox->isChecked()) {
+            job = new GpgME::GpgJob(mCtx, GpgME::GpgJob::EncryptSignFile);
+            job->setSigners(*mKeyList->getPrivateChecked());
+        } else {
+            job = new GpgME::GpgJob(mCtx, GpgME::GpgJob::EncryptFile);
+        }
+        job->setKeys(*mKeyList->getChecked());
+        job->setArmor(armorCheckBox->isChecked());
+    } else {
+        job = new GpgME::GpgJob(mCtx, GpgME::GpgJob::DecryptFile);
+    }
+    job->setFiles(inputFileEdit->text(), outputFileEdit->text());
+
+    // the files are streamed through gpg in the job pool, the progress
+    // dialog keeps the gui responsive and allows to cancel the job.
+    // the range is in kB, int would overflow for files above 2 GB
+    QProgressDialog progress(tr("Processing %1...").arg(QFileInfo(inputFileEdit->text()).fileName()),
+                             tr("Cancel"), 0, qMax(Q_INT64_C(1), QFileInfo(inputFileEdit->text()).size() / 1024), this);
+    progress.setWindowModality(Qt::WindowModal);
+    progress.setMinimumDuration(500);
+    mProgress = &progress;
+    mProgressTime.start();
+
+    QEventLoop loop;
+    connect(job, SIGNAL(signalFinished(GpgME::GpgJob*)), &loop, SLOT(quit()));
+    connect(job, SIGNAL(signalProgress(qint64, qint64)), this, SLOT(slotJobProgress(qint64, qint64)));
+    connect(&progress, SIGNAL(canceled()), job, SLOT(cancel()));
+    mJob = job;
+    buttonBox->setEnabled(false);
+    mCtx->startJob(job);
+    loop.exec();
+    mJob = 0;
+    buttonBox->setEnabled(true);
+    mProgress = 0;
+
+    bool success = job->success();
+    bool canceled = job->isCanceled();
+    QString errorString = job->errorString();
+    delete job;
+
+    if (!success) {
+        if (!errorString.isEmpty() && !canceled) {
+            QMessageBox::critical(this, windowTitle(), errorString);
+        }
         return;
     }
 
-    QDataStream out(&outfile);
-    out.writeRawData(outBuffer->data(), outBuffer->length());
-    outfile.close();
     QMessageBox::information(0, "Done", "Output saved to " + outputFileEdit->text());
 
     accept();
 }
 
+void FileEncryptionDialog::reject()
+{
+    if (mJob) {
+        mJob->cancel();
+        return;
+    }
+    QDialog::reject();
+}
+
+void FileEncryptionDialog::slotJobProgress(qint64 current, qint64 total)
+{
+    if (!mProgress) {
+        return;
+    }
+    QString text = GpgME::GpgContext::progressText(current, total, mProgressTime.elapsed());
+    mProgress->setLabelText(QFileInfo(inputFileEdit->text()).fileName() + "\n" + text);
+    mProgress->setValue(current / 1024);
+
+    // mirror the progress in the status bar of the main window
+    if (parentWidget()) {
+        QStatusTipEvent tip(text);
+        QApplication::sendEvent(parentWidget(), &tip);
+    }
+}
+
 void FileEncryptionDialog::slotShowKeyList()
 {
     mKeyList->show();
+    armorCheckBox->show();
+    signCheckBox->show();
 }
 
 void FileEncryptionDialog::slotHideKeyList()
 {
     mKeyList->hide();
+    armorCheckBox->hide();
+    signCheckBox->hide();
+}
+
+QString FileEncryptionDialog::encryptedSuffix() const
+{
+    return armorCheckBox->isChecked() ? ".asc" : ".gpg";
+}
+
+void FileEncryptionDialog::slotArmorChanged()
+{
+    QString ofn = outputFileEdit->text();
+    if (ofn.endsWith(".asc", Qt::CaseInsensitive) || ofn.endsWith(".gpg", Qt::CaseInsensitive)) {
+        ofn.chop(4);
+        outputFileEdit->setText(ofn + encryptedSuffix());
+    }
 }
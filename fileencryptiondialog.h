@@ -23,6 +23,7 @@
 #define __FILEENCRYPTIONDIALOG_H__
 
 #include "gpgcontext.h"
+#include "gpgjob.h"
 #include "keylist.h"
 
 QT_BEGIN_NAMESPACE
@@ -37,6 +38,7 @@ class QVBoxLayout;
 class QDebug;
 class QFileDialog;
 class QRadioButton;
+class QCheckBox;
 QT_END_NAMESPACE
 
 /**
@@ -98,13 +100,35 @@ public slots:
      */
     void slotShowKeyList();
 
+private slots:
+    /**
+     * @details Switch the suffix of the output file between .gpg and .asc
+     */
+    void slotArmorChanged();
+    /**
+     * @details Show the progress of the running job
+     */
+    void slotJobProgress(qint64 current, qint64 total);
+
 private:
+    QString encryptedSuffix() const;
+    QCheckBox *armorCheckBox; /** ascii armored instead of binary output for encryption */
+    QCheckBox *signCheckBox; /** sign with the checked private keys while encrypting */
     QLineEdit *outputFileEdit; /**< TODO */
     QLineEdit *inputFileEdit; /**< TODO */
     QRadioButton *radioEnc; /**< TODO */
     QRadioButton *radioDec; /**< TODO */
     DialogAction mAction; /**< TODO */
+    QProgressDialog *mProgress; /** progress of the running job, 0 if none */
+    QTime mProgressTime; /** started with the job */
+    QDialogButtonBox *buttonBox; /** disabled while the job runs */
+    GpgME::GpgJob *mJob; /** the running job, 0 if none */
 protected:
+    /**
+     * @details Closing while the job runs cancels it
+     */
+    void reject();
+
     GpgME::GpgContext *mCtx; /**< TODO */
     KeyList *mKeyList; /**< TODO */
 
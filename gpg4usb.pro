@@ -21,10 +21,10 @@ HEADERS += attachments.h \
     gpgcontext.h \
     mainwindow.h \
     fileencryptiondialog.h \
+    batchencryptiondialog.h \
     keyimportdetaildialog.h \
     mime.h \
     keygendialog.h \
-    keygenthread.h \
     keydetailsdialog.h \
     keylist.h \
     keymgmt.h \
@@ -40,17 +40,26 @@ HEADERS += attachments.h \
     wizard.h \
     helppage.h \
     findwidget.h \
-    gpgconstants.h
+    gpgconstants.h \
+    gpgjob.h \
+    gpgbatch.h \
+    gpgprocess.h \
+    gpgkeystore.h \
+    keylistmodel.h \
+    keysearchindex.h \
+    pgpkeyreader.h \
+    singleinstance.h \
+    startuptimer.h
 
 SOURCES += attachments.cpp \
     gpgcontext.cpp \
     mainwindow.cpp \
     main.cpp \
     fileencryptiondialog.cpp \
+    batchencryptiondialog.cpp \
     keyimportdetaildialog.cpp \
     mime.cpp \
     keygendialog.cpp \
-    keygenthread.cpp \
     keydetailsdialog.cpp \
     keylist.cpp \
     keymgmt.cpp \
@@ -66,7 +75,16 @@ SOURCES += attachments.cpp \
     wizard.cpp \
     helppage.cpp \
     findwidget.cpp \
-    gpgconstants.cpp
+    gpgconstants.cpp \
+    gpgjob.cpp \
+    gpgbatch.cpp \
+    gpgprocess.cpp \
+    gpgkeystore.cpp \
+    keylistmodel.cpp \
+    keysearchindex.cpp \
+    pgpkeyreader.cpp \
+    singleinstance.cpp \
+    startuptimer.cpp
 
 RC_FILE = gpg4usb.rc
 
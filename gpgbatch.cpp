@@ -0,0 +1,189 @@
+/*
+ *      gpgbatch.cpp
+ *
+ *      Copyright 2008 gpg4usb-team <gpg4usb@cpunk.de>
+ *
+ *      This file is part of gpg4usb.
+ *
+ *      Gpg4usb is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      Gpg4usb is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with gpg4usb.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "gpgbatch.h"
+
+namespace GpgME
+{
+
+GpgBatch::GpgBatch(GpgContext *ctx, GpgJob::Operation operation, QObject *parent)
+        : QObject(parent)
+{
+    mCtx = ctx;
+    mOperation = operation;
+    mArmor = false;
+    mNext = 0;
+    // the job pool has one thread per core, more jobs would only wait in its queue
+    mMaxRunning = qMax(1, QThread::idealThreadCount());
+    mCanceled = false;
+    mFinished = 0;
+    mFailed = 0;
+    mBytesProcessed = 0;
+    mBytesTotal = 0;
+}
+
+void GpgBatch::setKeys(const QStringList &uidList)
+{
+    mKeys = uidList;
+}
+
+void GpgBatch::setSigners(const QStringList &signerList)
+{
+    mSigners = signerList;
+}
+
+void GpgBatch::setArmor(bool armor)
+{
+    mArmor = armor;
+}
+
+void GpgBatch::addFile(const QString &inFileName, const QString &outFileName)
+{
+    mInFileNames.append(inFileName);
+    mOutFileNames.append(outFileName);
+    qint64 size = QFileInfo(inFileName).size();
+    mFileSizes.append(size);
+    mBytesTotal += size;
+}
+
+int GpgBatch::count() const
+{
+    return mInFileNames.size();
+}
+
+QString GpgBatch::inFileName(int index) const
+{
+    return mInFileNames.at(index);
+}
+
+QString GpgBatch::outFileName(int index) const
+{
+    return mOutFileNames.at(index);
+}
+
+void GpgBatch::start()
+{
+    mTime.start();
+    while (mRunning.size() < mMaxRunning && mNext < count()) {
+        startNext();
+    }
+    if (mRunning.isEmpty()) {
+        emit signalFinished();
+    }
+}
+
+void GpgBatch::cancel()
+{
+    mCanceled = true;
+    foreach (GpgJob *job, mRunning.keys()) {
+        job->cancel();
+    }
+}
+
+bool GpgBatch::isRunning() const
+{
+    return !mRunning.isEmpty();
+}
+
+int GpgBatch::finishedCount() const
+{
+    return mFinished;
+}
+
+int GpgBatch::failedCount() const
+{
+    return mFailed;
+}
+
+qint64 GpgBatch::bytesProcessed() const
+{
+    qint64 bytes = mBytesProcessed;
+    foreach (qint64 running, mRunningBytes) {
+        bytes += running;
+    }
+    return bytes;
+}
+
+qint64 GpgBatch::bytesTotal() const
+{
+    return mBytesTotal;
+}
+
+/** Milliseconds since start()
+ */
+int GpgBatch::elapsed() const
+{
+    return mTime.elapsed();
+}
+
+void GpgBatch::startNext()
+{
+    GpgJob *job = new GpgJob(mCtx, mOperation);
+    job->setKeys(mKeys);
+    job->setSigners(mSigners);
+    job->setArmor(mArmor);
+    job->setFiles(mInFileNames.at(mNext), mOutFileNames.at(mNext));
+    connect(job, SIGNAL(signalFinished(GpgME::GpgJob*)), this, SLOT(slotJobFinished(GpgME::GpgJob*)));
+    connect(job, SIGNAL(signalProgress(qint64, qint64)), this, SLOT(slotJobProgress(qint64, qint64)));
+    mRunning.insert(job, mNext);
+    mNext++;
+    mCtx->startJob(job);
+}
+
+void GpgBatch::slotJobFinished(GpgME::GpgJob *job)
+{
+    int index = mRunning.take(job);
+    mRunningBytes.remove(job);
+    bool success = job->success();
+    QString errorString = job->errorString();
+    bool canceled = job->isCanceled();
+    job->deleteLater();
+
+    // canceled files are neither done nor failed
+    if (!canceled) {
+        mFinished++;
+        if (!success) {
+            mFailed++;
+        }
+        mBytesProcessed += mFileSizes.at(index);
+    }
+
+    if (!mCanceled && mNext < count()) {
+        startNext();
+    }
+
+    emit signalFileFinished(index, success, errorString);
+    if (mRunning.isEmpty()) {
+        emit signalFinished();
+    }
+}
+
+void GpgBatch::slotJobProgress(qint64 current, qint64 /*total*/)
+{
+    // a progress report may still be queued after the job finished
+    GpgJob *job = qobject_cast<GpgJob *>(sender());
+    if (job && mRunning.contains(job)) {
+        mRunningBytes.insert(job, current);
+        emit signalProgress();
+    }
+}
+
+} // namespace GpgME
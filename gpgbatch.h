@@ -0,0 +1,115 @@
+/*
+ *      gpgbatch.h
+ *
+ *      Copyright 2008 gpg4usb-team <gpg4usb@cpunk.de>
+ *
+ *      This file is part of gpg4usb.
+ *
+ *      Gpg4usb is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      Gpg4usb is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with gpg4usb.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef __GPGBATCH_H__
+#define __GPGBATCH_H__
+
+#include "gpgjob.h"
+
+namespace GpgME
+{
+
+/**
+ * @brief Runs a file operation for a list of files in the job pool
+ *
+ * @details At most one job per core is handed to the pool at a time, the next
+ * file is started when a job finishes. So thousands of files don't queue
+ * thousands of jobs.
+ */
+class GpgBatch : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @param ctx The master context, whose job pool runs the jobs
+     * @param operation EncryptFile, EncryptSignFile or DecryptFile
+     */
+    GpgBatch(GpgContext *ctx, GpgJob::Operation operation, QObject *parent = 0);
+
+    /**
+     * @details Keys and armor passed on to every job, see GpgJob.
+     */
+    void setKeys(const QStringList &uidList);
+    void setSigners(const QStringList &signerList);
+    void setArmor(bool armor);
+
+    void addFile(const QString &inFileName, const QString &outFileName);
+    int count() const;
+    QString inFileName(int index) const;
+    QString outFileName(int index) const;
+
+    void start();
+    /**
+     * @details Start no further files and abort the running ones, they are
+     * reported as failed with the error "Canceled".
+     */
+    void cancel();
+    bool isRunning() const;
+
+    /**
+     * @details Progress, updated before signalFileFinished is emitted.
+     * bytesProcessed() includes the bytes read of the running files.
+     */
+    int finishedCount() const;
+    int failedCount() const;
+    qint64 bytesProcessed() const;
+    qint64 bytesTotal() const;
+    int elapsed() const;
+
+signals:
+    void signalFileFinished(int index, bool success, const QString &errorString);
+    void signalFinished();
+    /**
+     * @details bytesProcessed() changed while files are running.
+     */
+    void signalProgress();
+
+private slots:
+    void slotJobFinished(GpgME::GpgJob *job);
+    void slotJobProgress(qint64 current, qint64 total);
+
+private:
+    void startNext();
+
+    GpgContext *mCtx;
+    GpgJob::Operation mOperation;
+    QStringList mKeys;
+    QStringList mSigners;
+    bool mArmor;
+    QStringList mInFileNames;
+    QStringList mOutFileNames;
+    QVector<qint64> mFileSizes;
+    QHash<GpgJob *, int> mRunning; /** running jobs and the index of their file */
+    QHash<GpgJob *, qint64> mRunningBytes; /** bytes read so far by the running jobs */
+    int mNext;
+    int mMaxRunning;
+    bool mCanceled;
+    int mFinished;
+    int mFailed;
+    qint64 mBytesProcessed;
+    qint64 mBytesTotal;
+    QTime mTime;
+};
+
+} // namespace GpgME
+
+#endif // __GPGBATCH_H__
@@ -20,20 +20,29 @@
  */
 
 #include "gpgcontext.h"
+#include "gpgjob.h"
+#include "gpgprocess.h"
+#include "pgpkeyreader.h"
 #include <unistd.h>    /* contains read/write */
 #ifdef _WIN32
 #include <windows.h>
 #endif
+#ifndef ECANCELED
+#define ECANCELED EINTR
+#endif
 namespace GpgME
 {
 
+QAtomicInt GpgContext::sKeyDBVersion(0);
+
 /** Constructor
  *  Set up gpgme-context, set paths to app-run path
+ *  or keyDir
  */
-GpgContext::GpgContext()
+GpgContext::GpgContext(const QString &keyDir, bool deferKeyList)
 {
-    /** get application path */
-    QString appPath = qApp->applicationDirPath();
+    mMaster = 0;
+    gpgKeys = keyDir;
 
     /** The function `gpgme_check_version' must be called before any other
      *  function in the library, because it initializes the thread support
@@ -56,6 +65,94 @@ GpgContext::GpgContext()
     gpgme_set_locale(NULL, LC_MESSAGES, setlocale(LC_MESSAGES, NULL));
 #endif
 
+    setupContext();
+
+    /** check if app is called with -d from command line */
+    if (qApp->arguments().contains("-d")) {
+        qDebug() << "gpgme_data_t debug on";
+        debug = true;
+    } else {
+        debug = false;
+    }
+
+    // one worker thread per core for jobs started with startJob()
+    mJobPool.setMaxThreadCount(QThread::idealThreadCount());
+
+    mKeyCacheVersion = sKeyDBVersion;
+    mKeySnapshotVersion = 0;
+    mKeyListingCount = 0;
+    mImportDigestsLoaded = false;
+    mOpenDevices = 0;
+
+    connect(this,SIGNAL(signalKeyDBChanged()),this,SLOT(slotClearKeyCache()));
+    connect(this,SIGNAL(signalKeyDBChanged()),this,SLOT(slotRefreshKeyList()));
+    connect(this,SIGNAL(signalKeysChanged(QStringList)),this,SLOT(slotClearKeyCache()));
+    connect(this,SIGNAL(signalKeysChanged(QStringList)),this,SLOT(slotUpdateKeys(QStringList)));
+    mKeyListJob = 0;
+    mKeyListJobStale = false;
+    mKeyDBScanJob = 0;
+    if (deferKeyList) {
+        // views work with the empty snapshot until the keys are listed
+        setKeySnapshot(new GpgKeyStore(), QStringList());
+        slotRefreshKeyListAsync();
+    } else {
+        slotRefreshKeyList();
+    }
+
+    // catch changes of the keydb made by other programs
+    mKeyDBTimer.setSingleShot(true);
+    mKeyDBTimer.setInterval(500);
+    connect(&mKeyDBTimer, SIGNAL(timeout()), this, SLOT(slotCheckKeyDB()));
+    connect(&mKeyDBWatcher, SIGNAL(directoryChanged(QString)), &mKeyDBTimer, SLOT(start()));
+    connect(&mKeyDBWatcher, SIGNAL(fileChanged(QString)), &mKeyDBTimer, SLOT(start()));
+    watchKeyDB();
+}
+
+/** Constructor for worker contexts
+ *  Same engine setup as the master, but no keylist. Passphrase requests
+ *  are passed to the master, changes of the keydb are signaled by it
+ */
+GpgContext::GpgContext(GpgContext *master)
+{
+    mMaster = master;
+    debug = master->debug;
+    gpgKeys = master->gpgKeys;
+
+    setupContext();
+
+    mKeyCacheVersion = sKeyDBVersion;
+    mKeySnapshotVersion = 0;
+    mKeyListJob = 0;
+    mKeyListJobStale = false;
+    mKeyDBScanJob = 0;
+    mKeyListingCount = 0;
+    mImportDigestsLoaded = false;
+    mOpenDevices = 0;
+
+    connect(this, SIGNAL(signalKeyDBChanged()), this, SLOT(slotClearKeyCache()));
+    connect(this, SIGNAL(signalKeyDBChanged()), mMaster, SIGNAL(signalKeyDBChanged()), Qt::QueuedConnection);
+    connect(this, SIGNAL(signalKeysChanged(QStringList)), this, SLOT(slotClearKeyCache()));
+    connect(this, SIGNAL(signalKeysChanged(QStringList)), mMaster, SIGNAL(signalKeysChanged(QStringList)), Qt::QueuedConnection);
+}
+
+/** Destructor
+ *  Release gpgme-context
+ */
+GpgContext::~GpgContext()
+{
+    slotClearKeyCache();
+    if (mCtx) gpgme_release(mCtx);
+    mCtx = 0;
+}
+
+/** Create the gpgme-context and point it to the
+ *  gpg binary and keydb in the app path
+ */
+void GpgContext::setupContext()
+{
+    /** get application path */
+    QString appPath = qApp->applicationDirPath();
+
     err = gpgme_new(&mCtx);
 
     checkErr(err);
@@ -68,7 +165,9 @@ GpgContext::GpgContext()
 #else
     gpgBin = appPath + "/bin/gpg";
 #endif
-    gpgKeys = appPath + "/keydb";
+    if (gpgKeys.isEmpty()) {
+        gpgKeys = appPath + "/keydb";
+    }
     /*    err = gpgme_ctx_set_engine_info(mCtx, GPGME_PROTOCOL_OpenPGP,
                                         gpgBin.toUtf8().constData(),
                                         gpgKeys.toUtf8().constData());*/
@@ -84,26 +183,76 @@ GpgContext::GpgContext()
     gpgme_set_armor(mCtx, 1);
     /** passphrase-callback */
     gpgme_set_passphrase_cb(mCtx, passphraseCb, this);
+    /** progress-callback, for operations without a device reporting bytes */
+    gpgme_set_progress_cb(mCtx, progressCb, this);
+}
 
-    /** check if app is called with -d from command line */
-    if (qApp->arguments().contains("-d")) {
-        qDebug() << "gpgme_data_t debug on";
-        debug = true;
-    } else {
-        debug = false;
-    }
-
-    connect(this,SIGNAL(signalKeyDBChanged()),this,SLOT(slotRefreshKeyList()));
-    slotRefreshKeyList();
+/** Start job in the job pool, the job runs on a
+ *  worker context of the pool thread
+ */
+void GpgContext::startJob(GpgJob *job)
+{
+    mJobPool.start(job);
 }
 
-/** Destructor
- *  Release gpgme-context
+/** The *Async functions start their jobs from the event loop, so
+ *  the caller can connect to signalFinished before the job runs
  */
-GpgContext::~GpgContext()
+void GpgContext::slotStartJob(GpgME::GpgJob *job)
 {
-    if (mCtx) gpgme_release(mCtx);
-    mCtx = 0;
+    startJob(job);
+}
+
+GpgJob *GpgContext::encryptAsync(const QStringList &uidList, const QByteArray &inBuffer)
+{
+    GpgJob *job = new GpgJob(this, GpgJob::Encrypt);
+    job->setKeys(uidList);
+    job->setInput(inBuffer);
+    QMetaObject::invokeMethod(this, "slotStartJob", Qt::QueuedConnection, Q_ARG(GpgME::GpgJob*, job));
+    return job;
+}
+
+GpgJob *GpgContext::decryptAsync(const QByteArray &inBuffer)
+{
+    GpgJob *job = new GpgJob(this, GpgJob::Decrypt);
+    job->setInput(inBuffer);
+    QMetaObject::invokeMethod(this, "slotStartJob", Qt::QueuedConnection, Q_ARG(GpgME::GpgJob*, job));
+    return job;
+}
+
+GpgJob *GpgContext::signAsync(const QStringList &uidList, const QByteArray &inBuffer)
+{
+    GpgJob *job = new GpgJob(this, GpgJob::Sign);
+    job->setKeys(uidList);
+    job->setInput(inBuffer);
+    QMetaObject::invokeMethod(this, "slotStartJob", Qt::QueuedConnection, Q_ARG(GpgME::GpgJob*, job));
+    return job;
+}
+
+GpgJob *GpgContext::importKeyAsync(const QByteArray &inBuffer)
+{
+    GpgJob *job = new GpgJob(this, GpgJob::ImportKey);
+    job->setInput(inBuffer);
+    QMetaObject::invokeMethod(this, "slotStartJob", Qt::QueuedConnection, Q_ARG(GpgME::GpgJob*, job));
+    return job;
+}
+
+GpgJob *GpgContext::multiFileAsync(MultiFileOperation operation, const QStringList &fileNames,
+                                   const QStringList &uidList, bool armor)
+{
+    GpgJob *job = new GpgJob(this, GpgJob::MultiFile);
+    job->setMultiFile(operation, fileNames);
+    job->setKeys(uidList);
+    job->setArmor(armor);
+    QMetaObject::invokeMethod(this, "slotStartJob", Qt::QueuedConnection, Q_ARG(GpgME::GpgJob*, job));
+    return job;
+}
+
+GpgJob *GpgContext::listKeysAsync()
+{
+    GpgJob *job = new GpgJob(this, GpgJob::ListKeys);
+    QMetaObject::invokeMethod(this, "slotStartJob", Qt::QueuedConnection, Q_ARG(GpgME::GpgJob*, job));
+    return job;
 }
 
 /** Import Key from QByteArray
@@ -111,67 +260,207 @@ GpgContext::~GpgContext()
  */
 GpgImportInformation GpgContext::importKey(QByteArray inBuffer)
 {
-    GpgImportInformation *importInformation = new GpgImportInformation();
-    err = gpgme_data_new_from_mem(&in, inBuffer.data(), inBuffer.size(), 1);
-    checkErr(err);
-    err = gpgme_op_import(mCtx, in);
-    gpgme_import_result_t result;
+    GpgImportInformation importInformation;
+    gpgme_data_t in = 0;
 
-    result = gpgme_op_import_result(mCtx);
-    if (result->unchanged){
-        importInformation->unchanged = result->unchanged;
-    }
-    if (result->considered){
-        importInformation->considered = result->considered;
-    }
-    if (result->no_user_id){
-        importInformation->no_user_id = result->no_user_id;
+    // inBuffer outlives the import, gpgme can read it in place
+    err = newDataFromBuffer(&in, inBuffer);
+    checkErr(err);
+    if (!err) {
+        importInformation = importData(in);
+        gpgme_data_release(in);
     }
-    if (result->imported){
-        importInformation->imported = result->imported;
+    return importInformation;
+}
+
+/** Import a keyring file in chunks of about 1 MB of whole keys,
+ *  so memory stays low and the import can be canceled
+ */
+GpgImportInformation GpgContext::importKeyFile(QIODevice *inFile, bool skipUnchanged)
+{
+    const int chunkSize = 1024 * 1024;
+    GpgImportInformation importInformation;
+    gpgme_data_t in = 0;
+
+    if (!PgpKeyReader::isBinary(inFile)) {
+        // armored keys are streamed to gpg in one piece
+        err = newDataFromDevice(&in, inFile);
+        checkErr(err);
+        if (!err) {
+            importInformation = importData(in);
+            gpgme_data_release(in);
+        }
+        return importInformation;
     }
-    if (result->imported_rsa){
-        importInformation->imported_rsa = result->imported_rsa;
+
+    QProgressDialog *progress = 0;
+    if (!mMaster) {
+        // the range is in kB, int would overflow for keyrings above 2 GB
+        progress = new QProgressDialog(tr("Importing keys..."), tr("Cancel"), 0,
+                                       qMax(Q_INT64_C(1), inFile->size() / 1024), QApplication::activeWindow());
+        progress->setWindowModality(Qt::WindowModal);
+        progress->setMinimumDuration(500);
     }
-    if (result->unchanged){
-        importInformation->unchanged = result->unchanged;
+
+    QSharedPointer<const GpgKeyStore> store = keySnapshot();
+    if (skipUnchanged) {
+        loadImportDigests();
     }
-    if (result->new_user_ids){
-        importInformation->new_user_ids = result->new_user_ids;
+    QHash<QString, QByteArray> chunkDigests;
+    bool digestsChanged = false;
+    // the snapshot is updated once for the whole file
+    QStringList changedFprs;
+
+    PgpKeyReader reader(inFile);
+    QByteArray chunk, key;
+    int keysRead = 0;
+    bool more = true;
+    while (more) {
+        more = reader.readKey(&key);
+        bool skip = false;
+        if (more && skipUnchanged) {
+            // a key is skipped, if gpg knows it and the same block was
+            // imported before, public and secret blocks are kept apart
+            QString fpr = reader.fingerprint();
+            QString digestKey = reader.isSecret() ? fpr + ":sec" : fpr;
+            QByteArray digest = QCryptographicHash::hash(key, QCryptographicHash::Sha1);
+            const GpgKey *known = fpr.isEmpty() ? 0 : store->findByFpr(fpr);
+            if (known && (known->privkey || !reader.isSecret())
+                    && mImportDigests.value(digestKey) == digest) {
+                importInformation.considered++;
+                if (reader.isSecret()) {
+                    importInformation.secret_read++;
+                    importInformation.secret_unchanged++;
+                } else {
+                    importInformation.unchanged++;
+                }
+                skip = true;
+            } else if (!fpr.isEmpty()) {
+                chunkDigests.insert(digestKey, digest);
+            }
+        }
+        if (more && !skip) {
+            chunk.append(key);
+        }
+
+        bool imported = false;
+        if (chunk.size() >= chunkSize || (!more && !chunk.isEmpty())) {
+            err = newDataFromBuffer(&in, chunk);
+            checkErr(err);
+            if (!err) {
+                importInformation.add(importData(in, &changedFprs));
+                gpgme_data_release(in);
+            }
+            if (!err && !chunkDigests.isEmpty()) {
+                QHashIterator<QString, QByteArray> it(chunkDigests);
+                while (it.hasNext()) {
+                    it.next();
+                    mImportDigests.insert(it.key(), it.value());
+                }
+                digestsChanged = true;
+            }
+            chunkDigests.clear();
+            chunk.clear();
+            imported = true;
+        }
+
+        keysRead++;
+        if (progress && (imported || keysRead % 256 == 0)) {
+            progress->setValue(inFile->pos() / 1024);
+            progress->setLabelText(tr("%1 keys read, %2 imported, %3 unchanged")
+                                   .arg(importInformation.considered)
+                                   .arg(importInformation.imported)
+                                   .arg(importInformation.unchanged));
+            if (progress->wasCanceled()) {
+                break;
+            }
+        }
     }
-    if (result->new_sub_keys){
-        importInformation->new_sub_keys = result->new_sub_keys;
+    delete progress;
+
+    if (!changedFprs.isEmpty()) {
+        emit signalKeysChanged(changedFprs);
     }
-    if (result->new_signatures){
-        importInformation->new_signatures = result->new_signatures;
+    if (digestsChanged) {
+        saveImportDigests();
     }
-    if (result->new_revocations){
-        importInformation->new_revocations  =result->new_revocations;
+    if (reader.hasError()) {
+        showError(tr("Import error"), tr("The keyring is damaged, only the keys before the damaged part were imported."));
     }
-    if (result->secret_read){
-        importInformation->secret_read = result->secret_read;
+    return importInformation;
+}
+
+/** The digests of imported key blocks are kept in the keydb,
+ *  so they are valid as long as the keyring they describe
+ */
+void GpgContext::loadImportDigests()
+{
+    if (mImportDigestsLoaded) {
+        return;
     }
-    if (result->secret_imported){
-        importInformation->secret_imported = result->secret_imported;
+    mImportDigestsLoaded = true;
+    QFile file(gpgKeys + "/importdigests");
+    if (file.open(QIODevice::ReadOnly)) {
+        QDataStream stream(&file);
+        stream >> mImportDigests;
     }
-    if (result->secret_unchanged){
-        importInformation->secret_unchanged = result->secret_unchanged;
+}
+
+void GpgContext::saveImportDigests()
+{
+    QFile file(gpgKeys + "/importdigests");
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        QDataStream stream(&file);
+        stream << mImportDigests;
     }
-    if (result->not_imported){
-        importInformation->not_imported = result->not_imported;
+}
+
+/** Import gpgme-Data in, emit the changed keys. With changedFprs
+ *  given, they are appended to it instead, for the caller to emit
+ */
+GpgImportInformation GpgContext::importData(gpgme_data_t in, QStringList *changedFprs)
+{
+    GpgImportInformation importInformation;
+    err = gpgme_op_import(mCtx, in);
+    checkErr(err);
+
+    gpgme_import_result_t result = gpgme_op_import_result(mCtx);
+    if (!result) {
+        return importInformation;
     }
+    importInformation.considered = result->considered;
+    importInformation.no_user_id = result->no_user_id;
+    importInformation.imported = result->imported;
+    importInformation.imported_rsa = result->imported_rsa;
+    importInformation.unchanged = result->unchanged;
+    importInformation.new_user_ids = result->new_user_ids;
+    importInformation.new_sub_keys = result->new_sub_keys;
+    importInformation.new_signatures = result->new_signatures;
+    importInformation.new_revocations = result->new_revocations;
+    importInformation.secret_read = result->secret_read;
+    importInformation.secret_imported = result->secret_imported;
+    importInformation.secret_unchanged = result->secret_unchanged;
+    importInformation.not_imported = result->not_imported;
+
+    QStringList fprs;
     gpgme_import_status_t status = result->imports;
     while (status != NULL) {
         GpgImportedKey key;
         key.importStatus = status->status;
         key.fpr = status->fpr;
-        importInformation->importedKeys.append(key);
-        status=status->next;
+        importInformation.importedKeys.append(key);
+        // a status of 0 means the key is unchanged
+        if (status->status != 0 && status->fpr) {
+            fprs << status->fpr;
+        }
+        status = status->next;
     }
-    checkErr(err);
-    emit signalKeyDBChanged();
-    gpgme_data_release(in);
-    return *importInformation;
+    if (changedFprs) {
+        *changedFprs << fprs;
+    } else if (!fprs.isEmpty()) {
+        emit signalKeysChanged(fprs);
+    }
+    return importInformation;
 }
 
 /** Generate New Key with values params
@@ -181,7 +470,46 @@ void GpgContext::generateKey(QString *params)
 {
     err = gpgme_op_genkey(mCtx, params->toAscii().data(), NULL, NULL);
     checkErr(err);
-    emit signalKeyDBChanged();
+
+    gpgme_genkey_result_t result = gpgme_op_genkey_result(mCtx);
+    if (!err && result && result->fpr) {
+        emit signalKeysChanged(QStringList() << result->fpr);
+    } else {
+        emit signalKeyDBChanged();
+    }
+}
+
+/** Generate a key with gpg --gen-key, params are passed
+ *  on stdin without the gpgme markup
+ */
+GpgProcess *GpgContext::generateKeyAsync(const QString &params)
+{
+    QString batchParams;
+    foreach (QString line, params.split('\n')) {
+        if (!line.contains("GnupgKeyParms")) {
+            batchParams += line + "\n";
+        }
+    }
+    batchParams += "%commit\n";
+
+    GpgProcess *gpg = new GpgProcess(gpgBin, gpgKeys);
+    connect(gpg, SIGNAL(signalStatus(QByteArray, QByteArray)),
+            this, SLOT(slotKeyGenStatus(QByteArray, QByteArray)));
+    gpg->start(QStringList() << "--gen-key", batchParams.toUtf8());
+    return gpg;
+}
+
+void GpgContext::slotKeyGenStatus(const QByteArray &keyword, const QByteArray &arguments)
+{
+    // KEY_CREATED <type> <fingerprint>
+    if (keyword == "KEY_CREATED") {
+        QList<QByteArray> fields = arguments.split(' ');
+        if (fields.size() >= 2) {
+            emit signalKeysChanged(QStringList() << QString(fields.at(1)));
+        } else {
+            emit signalKeyDBChanged();
+        }
+    }
 }
 
 /** Export Key to QByteArray
@@ -189,29 +517,86 @@ void GpgContext::generateKey(QString *params)
  */
 bool GpgContext::exportKeys(QStringList *uidList, QByteArray *outBuffer)
 {
-    size_t read_bytes;
     gpgme_data_t out = 0;
+    QBuffer outDevice;
     outBuffer->resize(0);
 
     if (uidList->count() == 0) {
-        QMessageBox::critical(0, "Export Keys Error", "No Keys Selected");
+        showError("Export Keys Error", "No Keys Selected");
         return false;
     }
 
-    for (int i = 0; i < uidList->count(); i++) {
-        err = gpgme_data_new(&out);
-        checkErr(err);
+    err = newDataToBuffer(&out, &outDevice, outBuffer, 0);
+    checkErr(err);
+    if (!err) {
+        err = exportKeysData(uidList, out);
+        gpgme_data_release(out);
+    }
+    if (err) {
+        outBuffer->resize(0);
+    }
+    return (err == GPG_ERR_NO_ERROR);
+}
 
-        err = gpgme_op_export(mCtx, uidList->at(i).toAscii().constData(), 0, out);
-        checkErr(err);
+bool GpgContext::exportKeysFile(QStringList *uidList, QIODevice *outFile)
+{
+    gpgme_data_t out = 0;
 
-        read_bytes = gpgme_data_seek(out, 0, SEEK_END);
+    if (uidList && uidList->count() == 0) {
+        showError("Export Keys Error", "No Keys Selected");
+        return false;
+    }
 
-        err = readToBuffer(out, outBuffer);
-        checkErr(err);
+    err = newDataFromDevice(&out, outFile);
+    checkErr(err);
+    if (!err) {
+        err = exportKeysData(uidList, out);
         gpgme_data_release(out);
     }
-    return true;
+    return (err == GPG_ERR_NO_ERROR);
+}
+
+/** Export the keys of uidList to out, with one gpg run per chunk of
+ *  keys, or a single run without patterns for the whole keyring
+ */
+gpgme_error_t GpgContext::exportKeysData(QStringList *uidList, gpgme_data_t out)
+{
+    // the patterns end up on the gpg command line, which windows
+    // limits to 32k characters
+    const int chunkSize = 500;
+
+    if (uidList == 0 || uidList->count() >= keySnapshot()->size()) {
+        QSet<QString> all;
+        if (uidList) {
+            foreach (GpgKey key, keySnapshot()->keys()) {
+                all.insert(key.id);
+            }
+        }
+        if (uidList == 0 || all == uidList->toSet()) {
+            err = gpgme_op_export(mCtx, 0, 0, out);
+            checkErr(err);
+            return err;
+        }
+    }
+
+    err = GPG_ERR_NO_ERROR;
+    for (int i = 0; i < uidList->count() && !err; i += chunkSize) {
+        QList<QByteArray> patterns;
+        const char *patternArray[chunkSize + 1];
+        int count = qMin(chunkSize, uidList->count() - i);
+        for (int j = 0; j < count; j++) {
+            patterns.append(uidList->at(i + j).toAscii());
+            patternArray[j] = patterns.last().constData();
+        }
+        patternArray[count] = 0;
+
+        err = gpgme_op_export_ext(mCtx, patternArray, 0, out);
+        checkErr(err);
+    }
+    if (err) {
+        showError(tr("Export Keys Error"), gpgErrString(err));
+    }
+    return err;
 }
 
 gpgme_key_t GpgContext::getKeyDetails(QString uid)
@@ -230,31 +615,30 @@ gpgme_key_t GpgContext::getKeyDetails(QString uid)
 /** List all availabe Keys (VERY much like kgpgme)
  */
 GpgKeyList GpgContext::listKeys()
+{
+    GpgKeyStore store;
+    listKeys(&store);
+    return store.keys();
+}
+
+/** Fill store with all keys of the keyring, private keys
+ *  are looked up by fingerprint and marked
+ */
+void GpgContext::listKeys(GpgKeyStore *store)
 {
     gpgme_error_t err;
     gpgme_key_t key;
 
-    GpgKeyList keys;
-    //TODO dont run the loop more often than necessary
+    store->clear();
+    // a worker lists the keyring for the snapshot of its master
+    (mMaster ? mMaster : this)->mKeyListingCount.ref();
     // list all keys ( the 0 is for all )
     err = gpgme_op_keylist_start(mCtx, NULL, 0);
     checkErr(err);
     while (!(err = gpgme_op_keylist_next(mCtx, &key))) {
-        GpgKey gpgkey;
-
-        if (!key->subkeys)
-            continue;
-
-        gpgkey.id = key->subkeys->keyid;
-        gpgkey.fpr = key->subkeys->fpr;
-        gpgkey.expired = (key->expired != 0);
-        gpgkey.revoked = (key->revoked != 0);
-
-        if (key->uids) {
-            gpgkey.name = QString::fromUtf8(key->uids->name);
-            gpgkey.email = QString::fromUtf8(key->uids->email);
+        if (key->subkeys) {
+            store->insert(toGpgKey(key));
         }
-        keys.append(gpgkey);
         gpgme_key_unref(key);
     }
     gpgme_op_keylist_end(mCtx);
@@ -262,187 +646,786 @@ GpgKeyList GpgContext::listKeys()
     // list only private keys ( the 1 does )
     gpgme_op_keylist_start(mCtx, NULL, 1);
     while (!(err = gpgme_op_keylist_next(mCtx, &key))) {
-        if (!key->subkeys)
-            continue;
-        // iterate keys, mark privates
-        GpgKeyList::iterator it = keys.begin();
-        while (it != keys.end()) {
-            if (key->subkeys->keyid == it->id.toStdString())
-                it->privkey = true;
-            it++;
+        if (key->subkeys && key->subkeys->fpr) {
+            store->markPrivate(key->subkeys->fpr);
         }
-
         gpgme_key_unref(key);
     }
     gpgme_op_keylist_end(mCtx);
+}
 
-    return keys;
+/** List only the keys with the primary fingerprints fprs and
+ *  update them in store, keys not in the keyring anymore are removed
+ */
+void GpgContext::updateKeys(GpgKeyStore *store, const QStringList &fprs)
+{
+    gpgme_key_t key;
+
+    // gpg gets the patterns on its command line, so keep the chunks small
+    const int chunkSize = 100;
+    for (int start = 0; start < fprs.size(); start += chunkSize) {
+        QStringList chunk = fprs.mid(start, chunkSize);
+        QList<QByteArray> patternData;
+        const char *patterns[chunkSize + 1];
+        foreach (QString fpr, chunk) {
+            patternData << fpr.toAscii();
+        }
+        for (int i = 0; i < patternData.size(); i++) {
+            patterns[i] = patternData.at(i).constData();
+        }
+        patterns[patternData.size()] = NULL;
+
+        QSet<QString> found;
+        gpgme_op_keylist_ext_start(mCtx, patterns, 0, 0);
+        while (!gpgme_op_keylist_next(mCtx, &key)) {
+            if (key->subkeys && key->subkeys->fpr) {
+                store->insert(toGpgKey(key));
+                found.insert(QString(key->subkeys->fpr).toUpper());
+            }
+            gpgme_key_unref(key);
+        }
+        gpgme_op_keylist_end(mCtx);
+
+        gpgme_op_keylist_ext_start(mCtx, patterns, 1, 0);
+        while (!gpgme_op_keylist_next(mCtx, &key)) {
+            if (key->subkeys && key->subkeys->fpr) {
+                store->markPrivate(key->subkeys->fpr);
+            }
+            gpgme_key_unref(key);
+        }
+        gpgme_op_keylist_end(mCtx);
+
+        foreach (QString fpr, chunk) {
+            if (!found.contains(fpr.toUpper())) {
+                store->remove(fpr);
+            }
+        }
+    }
 }
 
-/** Delete keys
+/** Copy the fields shown in the gui from a gpgme key
  */
+GpgKey GpgContext::toGpgKey(gpgme_key_t key)
+{
+    GpgKey gpgkey;
+
+    gpgkey.id = key->subkeys->keyid;
+    gpgkey.fpr = key->subkeys->fpr;
+    gpgkey.expired = (key->expired != 0);
+    gpgkey.revoked = (key->revoked != 0);
+
+    if (key->uids) {
+        gpgkey.name = QString::fromUtf8(key->uids->name);
+        gpgkey.email = QString::fromUtf8(key->uids->email);
+    }
+
+    for (gpgme_subkey_t sub = key->subkeys; sub; sub = sub->next) {
+        if (sub->keyid) {
+            gpgkey.subkeyIds << sub->keyid;
+        }
+        if (sub->fpr) {
+            gpgkey.subkeyFprs << sub->fpr;
+        }
+    }
+
+    // in the order of the gpg listing read by scanKeyDB(): primary key, uids, subkeys
+    QString uids, subkeys;
+    for (gpgme_user_id_t uid = key->uids; uid; uid = uid->next) {
+        uids += QString("%1:%2;").arg(uid->revoked ? "r" : "-").arg(QString::fromUtf8(uid->uid));
+    }
+    for (gpgme_subkey_t sub = key->subkeys; sub; sub = sub->next) {
+        QString subkey = QString("%1:%2:%3;").arg(sub->keyid)
+                         .arg(sub->revoked ? "r" : (sub->expired ? "e" : "-")).arg(sub->expires);
+        if (sub == key->subkeys) {
+            gpgkey.state = subkey;
+        } else {
+            subkeys += subkey;
+        }
+    }
+    gpgkey.state += uids + subkeys;
+    return gpgkey;
+}
 
+/** Delete keys with one gpg run per chunk of keys,
+ *  the change is signaled once for all keys
+ */
 void GpgContext::deleteKeys(QStringList *uidList)
 {
-    QString tmp;
-    gpgme_key_t key;
+    // chunks keep the gpg command line below the 32k limit of windows
+    const int chunkSize = 100;
+
+    // the keys are resolved by the key store, gpg needs fingerprints
+    // to delete secret keys in batch mode. Keys missing in the snapshot,
+    // e.g. while the deferred listing runs, are looked up in the keyring
+    QSharedPointer<const GpgKeyStore> store = keySnapshot();
+    QStringList fprs;
+    foreach (QString uid, *uidList) {
+        const GpgKey *key = store->findById(uid);
+        if (!key) {
+            key = store->findByFpr(uid);
+        }
+        QString fpr;
+        if (key) {
+            fpr = key->fpr;
+        } else {
+            gpgme_key_t gpgmeKey = cachedKey(uid);
+            if (gpgmeKey && gpgmeKey->subkeys) {
+                fpr = gpgmeKey->subkeys->fpr;
+            }
+        }
+        if (!fpr.isEmpty() && !fprs.contains(fpr)) {
+            fprs << fpr;
+        }
+    }
+    if (fprs.isEmpty()) {
+        return;
+    }
 
-    foreach(tmp,  *uidList) {
-        gpgme_op_keylist_start(mCtx, tmp.toAscii().constData(), 0);
-        gpgme_op_keylist_next(mCtx, &key);
-        gpgme_op_keylist_end(mCtx);
-        gpgme_op_delete(mCtx, key, 1);
+    QProgressDialog *progress = 0;
+    if (!mMaster && fprs.size() > chunkSize) {
+        progress = new QProgressDialog(tr("Deleting keys..."), tr("Cancel"), 0, fprs.size(), QApplication::activeWindow());
+        progress->setWindowModality(Qt::WindowModal);
+        progress->setMinimumDuration(500);
+    }
+
+    QStringList deletedFprs;
+    QString errorString;
+    for (int i = 0; i < fprs.size(); i += chunkSize) {
+        if (progress && progress->wasCanceled()) {
+            break;
+        }
+        QStringList chunk = fprs.mid(i, chunkSize);
+        GpgProcess gpg(gpgBin, gpgKeys);
+        QEventLoop loop;
+        connect(&gpg, SIGNAL(signalFinished(bool)), &loop, SLOT(quit()));
+        if (progress) {
+            connect(progress, SIGNAL(canceled()), &gpg, SLOT(cancel()));
+        }
+        gpg.start(QStringList() << "--yes" << "--delete-secret-and-public-keys" << chunk);
+        if (gpg.isRunning()) {
+            loop.exec();
+        }
+
+        // a failed run may have deleted some of the keys, the update drops
+        // only the keys which are gone. Of a canceled run only the keys
+        // gpg got to before are recorded
+        if (gpg.isCanceled()) {
+            slotClearKeyCache();
+            foreach (QString fpr, chunk) {
+                const GpgKey *key = store->findByFpr(fpr);
+                gpgme_key_t secretKey = 0;
+                if (!cachedKey(fpr) || (key && key->privkey
+                        && gpgme_get_key(mCtx, fpr.toAscii().constData(), &secretKey, 1))) {
+                    deletedFprs << fpr;
+                }
+                if (secretKey) {
+                    gpgme_key_unref(secretKey);
+                }
+            }
+            break;
+        }
+        deletedFprs << chunk;
+        if (!gpg.success()) {
+            errorString = gpg.errorString();
+        }
+        if (progress) {
+            progress->setValue(qMin(i + chunkSize, fprs.size()));
+        }
+    }
+    delete progress;
+
+    if (!deletedFprs.isEmpty()) {
+        emit signalKeysChanged(deletedFprs);
+    }
+    if (!errorString.isEmpty()) {
+        showError(tr("Deleting Keys"), errorString);
     }
-    emit signalKeyDBChanged();
 }
 
 /** Encrypt inBuffer for reciepients-uids, write
  *  result to outBuffer
  */
-bool GpgContext::encrypt(QStringList *uidList, const QByteArray &inBuffer, QByteArray *outBuffer)
+bool GpgContext::encrypt(QStringList *uidList, const QByteArray &inBuffer, QByteArray *outBuffer, bool armor)
+{
+    return encryptSign(uidList, 0, inBuffer, outBuffer, armor);
+}
+
+/** Encrypt inBuffer for reciepients-uids and sign it with
+ *  the keys of signerList in one gpg run, write result to outBuffer
+ */
+bool GpgContext::encryptSign(QStringList *uidList, QStringList *signerList, const QByteArray &inBuffer, QByteArray *outBuffer, bool armor)
 {
 
     gpgme_data_t in = 0, out = 0;
+    QBuffer outDevice;
     outBuffer->resize(0);
 
+    if (!checkKeySelection(uidList, signerList)) {
+        return false;
+    }
+
+    if (mCtx) {
+        err = newDataFromBuffer(&in, inBuffer);
+        checkErr(err);
+        if (!err) {
+            // binary output is about as large as the input, armor adds a third
+            qint64 expectedSize = inBuffer.size() + inBuffer.size() / 64 + 4096;
+            if (armor) {
+                expectedSize = expectedSize / 48 * 65;
+            }
+            err = newDataToBuffer(&out, &outDevice, outBuffer, expectedSize);
+            checkErr(err);
+            if (!err) {
+                err = encryptData(uidList, signerList, in, out, armor);
+            }
+        }
+    }
+    if (in) {
+        gpgme_data_release(in);
+    }
+    if (out) {
+        gpgme_data_release(out);
+    }
+    if (err) {
+        outBuffer->resize(0);
+    }
+    return (err == GPG_ERR_NO_ERROR);
+}
+
+/** Encrypt inFile for reciepients-uids, stream
+ *  result to outFile
+ */
+bool GpgContext::encryptFile(QStringList *uidList, QIODevice *inFile, QIODevice *outFile, bool armor)
+{
+    return encryptSignFile(uidList, 0, inFile, outFile, armor);
+}
+
+/** Streaming counterpart of encryptSign
+ */
+bool GpgContext::encryptSignFile(QStringList *uidList, QStringList *signerList, QIODevice *inFile, QIODevice *outFile, bool armor)
+{
+    gpgme_data_t in = 0, out = 0;
+
+    if (!checkKeySelection(uidList, signerList)) {
+        return false;
+    }
+
+    if (mCtx) {
+        err = newDataFromDevice(&in, inFile);
+        checkErr(err);
+        if (!err) {
+            err = newDataFromDevice(&out, outFile);
+            checkErr(err);
+            if (!err) {
+                err = encryptData(uidList, signerList, in, out, armor);
+            }
+        }
+    }
+    if (in) {
+        gpgme_data_release(in);
+    }
+    if (out) {
+        gpgme_data_release(out);
+    }
+    return (err == GPG_ERR_NO_ERROR);
+}
+
+/** Show an error, if there are no recipients or
+ *  signers are wanted but none selected
+ */
+bool GpgContext::checkKeySelection(QStringList *uidList, QStringList *signerList)
+{
     if (uidList->count() == 0) {
-        QMessageBox::critical(0, tr("No Key Selected"), tr("No Key Selected"));
+        showError(tr("No Key Selected"), tr("No Key Selected"));
+        return false;
+    }
+    if (signerList && signerList->count() == 0) {
+        showError(tr("Key Selection"), tr("No Private Key Selected"));
         return false;
     }
+    return true;
+}
 
+/** Look up the keys for the reciepients-uids and
+ *  encrypt gpgme-Data in to out, if signerList is given
+ *  sign with these keys in the same run
+ */
+gpgme_error_t GpgContext::encryptData(QStringList *uidList, QStringList *signerList, gpgme_data_t in, gpgme_data_t out, bool armor)
+{
     //gpgme_encrypt_result_t e_result;
     gpgme_key_t recipients[uidList->count()+1];
 
-    /* get key for user */
+    /* get key for user, the handles are owned by the key cache */
     for (int i = 0; i < uidList->count(); i++) {
-        // the last 0 is for public keys, 1 would return private keys
-        gpgme_op_keylist_start(mCtx, uidList->at(i).toAscii().constData(), 0);
-        gpgme_op_keylist_next(mCtx, &recipients[i]);
-        gpgme_op_keylist_end(mCtx);
+        recipients[i] = cachedKey(uidList->at(i));
     }
     //Last entry in array has to be NULL
     recipients[uidList->count()] = NULL;
 
-    //If the last parameter isnt 0, a private copy of data is made
+    // armor is on for the context, switch it off for this operation only
+    gpgme_set_armor(mCtx, armor);
+    if (signerList) {
+        gpgme_signers_clear(mCtx);
+        for (int i = 0; i < signerList->count(); i++) {
+            err = gpgme_signers_add(mCtx, cachedKey(signerList->at(i)));
+            checkErr(err);
+        }
+        err = gpgme_op_encrypt_sign(mCtx, recipients, GPGME_ENCRYPT_ALWAYS_TRUST, in, out);
+        gpgme_signers_clear(mCtx);
+
+        if (! settings.value("general/rememberPassword").toBool()) {
+            clearPasswordCache();
+        }
+    } else {
+        err = gpgme_op_encrypt(mCtx, recipients, GPGME_ENCRYPT_ALWAYS_TRUST, in, out);
+    }
+    gpgme_set_armor(mCtx, 1);
+    checkErr(err);
+
+    if (err != GPG_ERR_NO_ERROR && gpg_err_code(err) != GPG_ERR_CANCELED) {
+        showError(tr("Error encrypting:"), gpgErrString(err));
+    }
+    return err;
+}
+
+/** Decrypt QByteAarray, return QByteArray
+ *  mainly from http://basket.kde.org/ (kgpgme.cpp)
+ */
+bool GpgContext::decrypt(const QByteArray &inBuffer, QByteArray *outBuffer)
+{
+    return decryptVerify(inBuffer, outBuffer, 0);
+}
+
+/** Decrypt and verify the signatures of the decrypted
+ *  message in one gpg run
+ */
+bool GpgContext::decryptVerify(const QByteArray &inBuffer, QByteArray *outBuffer, gpgme_signature_t *signatures)
+{
+    gpgme_data_t in = 0, out = 0;
+    QBuffer outDevice;
+
+    outBuffer->resize(0);
+    if (signatures) {
+        *signatures = 0;
+    }
     if (mCtx) {
-		err = gpgme_data_new_from_mem(&in, inBuffer.data(), inBuffer.size(), 1);
-		checkErr(err);
+        err = newDataFromBuffer(&in, inBuffer);
+        checkErr(err);
         if (!err) {
-			err = gpgme_data_new(&out);
-			checkErr(err);
-	        if (!err) {
-				err = gpgme_op_encrypt(mCtx, recipients, GPGME_ENCRYPT_ALWAYS_TRUST, in, out);
-				checkErr(err);
-				if (!err) {
-					err = readToBuffer(out, outBuffer);
-					checkErr(err);
-				}
-			}
-		}
-	}
-    /* unref all keys */
-    for (int i = 0; i <= uidList->count(); i++) {
-        gpgme_key_unref(recipients[i]);
+            // without compression the plaintext is smaller than the message,
+            // compressed plaintext grows the buffer as needed
+            err = newDataToBuffer(&out, &outDevice, outBuffer, inBuffer.size());
+            checkErr(err);
+            if (!err) {
+                err = decryptData(in, out, signatures != 0);
+            }
+        }
     }
+
+    if (!err && signatures) {
+        gpgme_verify_result_t result = gpgme_op_verify_result(mCtx);
+        if (result) {
+            *signatures = result->signatures;
+        }
+    }
+
+    if (! settings.value("general/rememberPassword").toBool()) {
+        clearPasswordCache();
+    }
+
     if (in) {
         gpgme_data_release(in);
     }
     if (out) {
         gpgme_data_release(out);
     }
+    if (err) {
+        outBuffer->resize(0);
+    }
     return (err == GPG_ERR_NO_ERROR);
 }
 
-/** Decrypt QByteAarray, return QByteArray
- *  mainly from http://basket.kde.org/ (kgpgme.cpp)
+/** Decrypt inFile, stream result to outFile
  */
-bool GpgContext::decrypt(const QByteArray &inBuffer, QByteArray *outBuffer)
+bool GpgContext::decryptFile(QIODevice *inFile, QIODevice *outFile)
 {
     gpgme_data_t in = 0, out = 0;
-    gpgme_decrypt_result_t result = 0;
-    QString errorString;
 
-    outBuffer->resize(0);
     if (mCtx) {
-        err = gpgme_data_new_from_mem(&in, inBuffer.data(), inBuffer.size(), 1);
+        err = newDataFromDevice(&in, inFile);
         checkErr(err);
         if (!err) {
-            err = gpgme_data_new(&out);
+            err = newDataFromDevice(&out, outFile);
             checkErr(err);
             if (!err) {
-                err = gpgme_op_decrypt(mCtx, in, out);
-                checkErr(err);
-
-                if(gpg_err_code(err) == GPG_ERR_DECRYPT_FAILED) {
-                    errorString.append(gpgErrString(err)).append("<br>");
-                    result = gpgme_op_decrypt_result(mCtx);
-                    checkErr(result->recipients->status);
-                    errorString.append(gpgErrString(result->recipients->status)).append("<br>");
-                    errorString.append(tr("<br>No private key with id %1 present in keyring").arg(result->recipients->keyid));
-                } else {
-                    errorString.append(gpgErrString(err)).append("<br>");
-                }
+                err = decryptData(in, out, false);
+            }
+        }
+    }
 
-                if (!err) {
-                    result = gpgme_op_decrypt_result(mCtx);
-                    if (result->unsupported_algorithm) {
-                        QMessageBox::critical(0, tr("Unsupported algorithm"), result->unsupported_algorithm);
-                    } else {
-                        err = readToBuffer(out, outBuffer);
-                        checkErr(err);
-                    }
-                }
+    if (! settings.value("general/rememberPassword").toBool()) {
+        clearPasswordCache();
+    }
+
+    if (in) {
+        gpgme_data_release(in);
+    }
+    if (out) {
+        gpgme_data_release(out);
+    }
+    return (err == GPG_ERR_NO_ERROR);
+}
+
+/** Run gpg --multifile on chunks of fileNames and map the
+ *  status output back to the files
+ */
+GpgFileResultList GpgContext::multiFile(MultiFileOperation operation, const QStringList &fileNames, QStringList *uidList, bool armor)
+{
+    // keep the command line short, windows limits it to 32k characters
+    const int chunkSize = 200;
+
+    GpgFileResultList results;
+    foreach (QString fileName, fileNames) {
+        GpgFileResult result;
+        result.fileName = fileName;
+        results.append(result);
+    }
+
+    QStringList args;
+    QByteArray stdIn;
+    args << "--yes" << "--multifile";
+    if (operation == EncryptFiles) {
+        if (uidList == 0 || uidList->count() == 0) {
+            showError(tr("No Key Selected"), tr("No Key Selected"));
+            return results;
+        }
+        args << "--trust-model" << "always";
+        foreach (QString uid, *uidList) {
+            args << "-r" << uid;
+        }
+        if (armor) {
+            args << "--armor";
+        }
+        args << "--encrypt-files";
+    } else if (operation == DecryptFiles) {
+        // gpg reads the password once and uses it for all files
+        if (!requestPassphrase(QString(), false)) {
+            return results;
+        }
+        stdIn = mPasswordCache + "\n";
+        args << "--passphrase-fd" << "0" << "--decrypt-files";
+    } else {
+        args << "--verify-files";
+    }
+    args << "--";
+
+    for (int i = 0; i < fileNames.size(); i += chunkSize) {
+        GpgProcess gpg(gpgBin, gpgKeys);
+        gpg.start(args + fileNames.mid(i, chunkSize), stdIn);
+        // a job is canceled from another thread, look at it every 100 ms
+        while (gpg.isRunning()) {
+            if (isCanceled()) {
+                gpg.cancel();
+            }
+            gpg.waitForFinished(100);
+        }
+        if (gpg.isCanceled()) {
+            for (int j = i; j < results.size(); j++) {
+                results[j].status = tr("Canceled");
+            }
+            break;
+        }
+
+        QList<QByteArray> status = gpg.statusLines();
+        parseMultiFileStatus(operation, status, gpg.log(), results.begin() + i,
+                             results.begin() + qMin(i + chunkSize, results.size()));
+
+        bool badPassphrase = false;
+        foreach (QByteArray line, status) {
+            badPassphrase |= line.startsWith("BAD_PASSPHRASE");
+        }
+        if (badPassphrase) {
+            clearPasswordCache();
+            for (int j = i + chunkSize; j < results.size(); j++) {
+                results[j].status = tr("Wrong password");
+            }
+            break;
+        }
+    }
+
+    if (operation == DecryptFiles) {
+        stdIn.fill('\0');
+        if (! settings.value("general/rememberPassword").toBool()) {
+            clearPasswordCache();
+        }
+    }
+    return results;
+}
+
+/** gpg starts every file with FILE_START and ends it with FILE_DONE, a
+ *  file succeeded, if the status of a good result was seen in between
+ *  and no error. Errors without status are looked up in the log.
+ */
+void GpgContext::parseMultiFileStatus(MultiFileOperation operation, const QList<QByteArray> &status, const QByteArray &log,
+                                      GpgFileResultList::iterator results, GpgFileResultList::iterator end)
+{
+    QByteArray goodKeyword = operation == EncryptFiles ? "END_ENCRYPTION"
+                             : (operation == DecryptFiles ? "DECRYPTION_OKAY" : "GOODSIG");
+
+    GpgFileResultList::iterator current = end;
+    bool started = false, good = false;
+    QString error;
+    foreach (QByteArray line, status) {
+        QByteArray keyword = line.left(line.indexOf(' '));
+
+        if (keyword == "FILE_START") {
+            current = !started ? results : (current == end ? end : current + 1);
+            started = true;
+            good = false;
+            error.clear();
+        } else if (current == end) {
+            continue;
+        } else if (keyword == "FILE_DONE") {
+            current->success = good && error.isEmpty();
+            if (!error.isEmpty()) {
+                current->status = error;
+            }
+        } else if (keyword == goodKeyword) {
+            good = true;
+            if (operation == VerifyFiles) {
+                // GOODSIG <long keyid> <uid>
+                current->status = QString::fromUtf8(line.mid(keyword.size() + 18));
+            }
+        } else if (keyword == "BAD_PASSPHRASE") {
+            error = tr("Wrong password");
+        } else if (error.isEmpty() && (keyword == "ERROR" || keyword == "NODATA"
+                   || keyword == "DECRYPTION_FAILED" || keyword == "BADMDC" || keyword == "INV_RECP"
+                   || (operation == VerifyFiles && (keyword == "BADSIG" || keyword == "ERRSIG")))) {
+            error = QString::fromUtf8(line);
+        }
+    }
+
+    // gpg logs "gpg: <file>: <reason>", prefer it to the status keyword
+    QList<QByteArray> logLines = log.split('\n');
+    for (GpgFileResultList::iterator it = results; it != end; ++it) {
+        if (it->success) {
+            continue;
+        }
+        QByteArray name = ": " + QFile::encodeName(it->fileName) + ": ";
+        foreach (QByteArray line, logLines) {
+            if (line.contains(name)) {
+                it->status = QString::fromLocal8Bit(line.mid(line.indexOf(name) + name.size()));
+                break;
             }
         }
+        if (it->status.isEmpty()) {
+            it->status = tr("Failed");
+        }
+    }
+}
+
+/** Decrypt gpgme-Data in to out, show a messagebox
+ *  if decryption fails
+ */
+gpgme_error_t GpgContext::decryptData(gpgme_data_t in, gpgme_data_t out, bool verify)
+{
+    gpgme_decrypt_result_t result = 0;
+    QString errorString;
+
+    if (verify) {
+        err = gpgme_op_decrypt_verify(mCtx, in, out);
+    } else {
+        err = gpgme_op_decrypt(mCtx, in, out);
+    }
+    checkErr(err);
+
+    if(gpg_err_code(err) == GPG_ERR_DECRYPT_FAILED) {
+        errorString.append(gpgErrString(err)).append("<br>");
+        result = gpgme_op_decrypt_result(mCtx);
+        checkErr(result->recipients->status);
+        errorString.append(gpgErrString(result->recipients->status)).append("<br>");
+        errorString.append(tr("<br>No private key with id %1 present in keyring").arg(result->recipients->keyid));
+    } else {
+        errorString.append(gpgErrString(err)).append("<br>");
+    }
+
+    if (!err) {
+        result = gpgme_op_decrypt_result(mCtx);
+        if (result->unsupported_algorithm) {
+            showError(tr("Unsupported algorithm"), result->unsupported_algorithm);
+            return gpgme_error(GPG_ERR_UNSUPPORTED_ALGORITHM);
+        }
+    }
+
+    if (gpg_err_code(err) != GPG_ERR_NO_ERROR && gpg_err_code(err) != GPG_ERR_CANCELED) {
+        showError(tr("Error decrypting:"), errorString);
+    }
+    return err;
+}
+
+/** Handle of the data callbacks: the device and the
+ *  context, which reports progress and may be canceled
+ */
+struct DeviceHandle {
+    GpgContext *ctx;
+    QIODevice *device;
+    qint64 reported; /** position of the last progress report */
+    bool reporting; /** counted in mOpenDevices, deviceReadCb() reports the progress */
+};
+
+/** Wrap a QIODevice into gpgme-Data, so gpg reads from
+ *  and writes to it in small chunks
+ */
+gpgme_error_t GpgContext::newDataFromDevice(gpgme_data_t *data, QIODevice *device)
+{
+    static struct gpgme_data_cbs deviceCbs = {
+        deviceReadCb,
+        deviceWriteCb,
+        deviceSeekCb,
+        deviceReleaseCb
+    };
+    DeviceHandle *handle = new DeviceHandle;
+    handle->ctx = this;
+    handle->device = device;
+    handle->reported = 0;
+    // only an input with a size reports progress, an output leaves it to gpg
+    handle->reporting = device->isReadable() && !device->isSequential();
+    gpgme_error_t err = gpgme_data_new_from_cbs(data, &deviceCbs, handle);
+    if (err) {
+        delete handle;
+    } else if (handle->reporting) {
+        mOpenDevices++;
+    }
+    return err;
+}
+
+/** gpgme-Data reading inBuffer in place, without a
+ *  private copy. inBuffer must outlive the data
+ */
+gpgme_error_t GpgContext::newDataFromBuffer(gpgme_data_t *data, const QByteArray &inBuffer)
+{
+    return gpgme_data_new_from_mem(data, inBuffer.constData(), inBuffer.size(), 0);
+}
+
+/** gpgme-Data writing through device straight into outBuffer,
+ *  instead of collecting the output in gpgme and copying it
+ *  over afterwards. Space for expectedSize bytes is reserved,
+ *  so usually outBuffer is allocated once. device must
+ *  outlive the data
+ */
+gpgme_error_t GpgContext::newDataToBuffer(gpgme_data_t *data, QBuffer *device, QByteArray *outBuffer, qint64 expectedSize)
+{
+    // a larger output grows outBuffer geometrically, don't reserve beyond 1 GB
+    outBuffer->resize(0);
+    outBuffer->reserve(qMin(expectedSize, Q_INT64_C(1024) * 1024 * 1024));
+    device->setBuffer(outBuffer);
+    device->open(QIODevice::WriteOnly);
+    return newDataFromDevice(data, device);
+}
+
+ssize_t GpgContext::deviceReadCb(void *handle, void *buffer, size_t size)
+{
+    // report every 256 kB, reading stays cheap for small buffers
+    const qint64 reportSize = 256 * 1024;
+
+    DeviceHandle *h = static_cast<DeviceHandle*>(handle);
+    if (h->ctx->isCanceled()) {
+        errno = ECANCELED;
+        return -1;
+    }
+    qint64 ret = h->device->read(static_cast<char*>(buffer), size);
+    if (ret < 0) {
+        errno = EIO;
+        return -1;
+    }
+    if (!h->device->isSequential()) {
+        qint64 pos = h->device->pos();
+        if (pos - h->reported >= reportSize || ret == 0) {
+            h->reported = pos;
+            emit h->ctx->signalProgress(pos, h->device->size());
+        }
+    }
+    return ret;
+}
+
+ssize_t GpgContext::deviceWriteCb(void *handle, const void *buffer, size_t size)
+{
+    DeviceHandle *h = static_cast<DeviceHandle*>(handle);
+    if (h->ctx->isCanceled()) {
+        errno = ECANCELED;
+        return -1;
     }
-    if (gpg_err_code(err) != GPG_ERR_NO_ERROR && gpg_err_code(err) != GPG_ERR_CANCELED) {
-        QMessageBox::critical(0, tr("Error decrypting:"), errorString);
-        return false;
+    qint64 ret = h->device->write(static_cast<const char*>(buffer), size);
+    if (ret < 0) {
+        errno = EIO;
+        return -1;
     }
+    return ret;
+}
 
-    if (! settings.value("general/rememberPassword").toBool()) {
-        clearPasswordCache();
+void GpgContext::deviceReleaseCb(void *handle)
+{
+    DeviceHandle *h = static_cast<DeviceHandle*>(handle);
+    if (h->reporting) {
+        h->ctx->mOpenDevices--;
     }
+    delete h;
+}
 
-    if (in) {
-        gpgme_data_release(in);
+off_t GpgContext::deviceSeekCb(void *handle, off_t offset, int whence)
+{
+    QIODevice *device = static_cast<DeviceHandle*>(handle)->device;
+    qint64 pos;
+
+    if (device->isSequential()) {
+        errno = ESPIPE;
+        return -1;
     }
-    if (out) {
-        gpgme_data_release(out);
+    switch (whence) {
+    case SEEK_SET:
+        pos = offset;
+        break;
+    case SEEK_CUR:
+        pos = device->pos() + offset;
+        break;
+    case SEEK_END:
+        pos = device->size() + offset;
+        break;
+    default:
+        errno = EINVAL;
+        return -1;
     }
-    return (err == GPG_ERR_NO_ERROR);
+    if (!device->seek(pos)) {
+        errno = EINVAL;
+        return -1;
+    }
+    return pos;
 }
 
-/**  Read gpgme-Data to QByteArray
- *   mainly from http://basket.kde.org/ (kgpgme.cpp)
+/** Pass the PROGRESS status of gpg on, unless an input
+ *  device reports the bytes read
  */
-#define BUF_SIZE (32 * 1024)
-gpgme_error_t GpgContext::readToBuffer(gpgme_data_t in, QByteArray *outBuffer)
+void GpgContext::progressCb(void *opaque, const char * /*what*/, int /*type*/, int current, int total)
 {
-    int ret;
-    gpgme_error_t err = GPG_ERR_NO_ERROR;
+    GpgContext *gpg = static_cast<GpgContext*>(opaque);
+    if (gpg->mOpenDevices == 0) {
+        emit gpg->signalProgress(current, total);
+    }
+}
 
-    ret = gpgme_data_seek(in, 0, SEEK_SET);
-    if (ret) {
-        err = gpgme_err_code_from_errno(errno);
-        checkErr(err, "failed dataseek in readToBuffer");
-    } else {
-        char *buf = new char[BUF_SIZE + 2];
+void GpgContext::cancel()
+{
+    mCancelRequested = 1;
+}
 
-        if (buf) {
-            while ((ret = gpgme_data_read(in, buf, BUF_SIZE)) > 0) {
-                uint size = outBuffer->size();
-                outBuffer->resize(size + ret);
-                memcpy(outBuffer->data() + size, buf, ret);
-            }
-            if (ret < 0) {
-                err = gpgme_err_code_from_errno(errno);
-                checkErr(err, "failed data_read in readToBuffer");
-            }
-            delete[] buf;
-        }
-    }
-    return err;
+bool GpgContext::isCanceled() const
+{
+    return mCancelRequested != 0;
+}
+
+void GpgContext::resetCancel()
+{
+    mCancelRequested = 0;
 }
 
 /** The Passphrase window, if not provided by env-Var GPG_AGENT_INFO
@@ -461,7 +1444,6 @@ gpgme_error_t GpgContext::passphrase(const char *uid_hint,
                                   int last_was_bad, int fd)
 {
     gpgme_error_t returnValue = GPG_ERR_CANCELED;
-    QString passwordDialogMessage;
     QString gpgHint = QString::fromUtf8(uid_hint);
     bool result;
 #ifdef _WIN32
@@ -469,27 +1451,7 @@ gpgme_error_t GpgContext::passphrase(const char *uid_hint,
 	HANDLE hd = (HANDLE)fd;
 #endif
 
-    if (last_was_bad) {
-        passwordDialogMessage += "<i>"+tr("Wrong password")+".</i><br><br>\n\n";
-        clearPasswordCache();
-    }
-
-    /** if uid provided */
-    if (!gpgHint.isEmpty()) {
-        // remove UID, leave only username & email
-        gpgHint.remove(0, gpgHint.indexOf(" "));
-        passwordDialogMessage += "<b>"+tr("Enter Password for")+"</b><br>" + gpgHint + "<br>";
-    }
-
-    if (mPasswordCache.isEmpty()) {
-        QString password = QInputDialog::getText(QApplication::activeWindow(), tr("Enter Password"),
-                           passwordDialogMessage, QLineEdit::Password,
-                           "", &result);
-
-        if (result) mPasswordCache = password.toAscii();
-    } else {
-        result = true;
-    }
+    result = requestPassphrase(gpgHint, last_was_bad != 0);
 
     if (result) {
 
@@ -520,6 +1482,91 @@ gpgme_error_t GpgContext::passphrase(const char *uid_hint,
     return returnValue;
 }
 
+/** Fill the password cache, asking the user if needed
+ */
+bool GpgContext::requestPassphrase(const QString &gpgHint, bool lastWasBad)
+{
+    bool result;
+    if (mMaster) {
+        // dialogs can only be shown in the gui thread, so let the master
+        // ask for the password. Only one worker at a time may ask.
+        static QMutex passphraseMutex;
+        QMutexLocker locker(&passphraseMutex);
+        QByteArray password;
+        if (lastWasBad) {
+            clearPasswordCache();
+        } else if (!mPasswordCache.isEmpty()) {
+            // asked again in the same job
+            return true;
+        }
+        QMetaObject::invokeMethod(mMaster, "slotWorkerPassphrase", Qt::BlockingQueuedConnection,
+                                  Q_RETURN_ARG(QByteArray, password),
+                                  Q_ARG(QString, gpgHint),
+                                  Q_ARG(bool, lastWasBad));
+        result = !password.isNull();
+        if (result) {
+            // an own copy, so both can be wiped
+            clearPasswordCache();
+            mPasswordCache = QByteArray(password.constData(), password.size());
+            password.fill('\0');
+        }
+    } else {
+        result = slotRequestPassphrase(gpgHint, lastWasBad);
+    }
+    return result;
+}
+
+/** Show the password dialog, if no password is cached
+ *  return false, if the dialog was canceled
+ */
+bool GpgContext::slotRequestPassphrase(QString gpgHint, bool lastWasBad)
+{
+    QString passwordDialogMessage;
+    bool result;
+
+    if (lastWasBad) {
+        passwordDialogMessage += "<i>"+tr("Wrong password")+".</i><br><br>\n\n";
+        clearPasswordCache();
+    }
+
+    /** if uid provided */
+    if (!gpgHint.isEmpty()) {
+        // remove UID, leave only username & email
+        gpgHint.remove(0, gpgHint.indexOf(" "));
+        passwordDialogMessage += "<b>"+tr("Enter Password for")+"</b><br>" + gpgHint + "<br>";
+    }
+
+    if (mPasswordCache.isEmpty()) {
+        QString password = QInputDialog::getText(QApplication::activeWindow(), tr("Enter Password"),
+                           passwordDialogMessage, QLineEdit::Password,
+                           "", &result);
+
+        if (result) mPasswordCache = password.toAscii();
+    } else {
+        result = true;
+    }
+    return result;
+}
+
+/** Ask for the password of a worker context in the gui
+ *  thread. The master keeps it only, if passwords are remembered.
+ *  Returns a null array, if the dialog was canceled
+ */
+QByteArray GpgContext::slotWorkerPassphrase(QString gpgHint, bool lastWasBad)
+{
+    QByteArray password;
+    if (slotRequestPassphrase(gpgHint, lastWasBad)) {
+        password = QByteArray(mPasswordCache.constData(), mPasswordCache.size());
+        if (password.isNull()) {
+            password = QByteArray("");
+        }
+    }
+    if (! settings.value("general/rememberPassword").toBool()) {
+        clearPasswordCache();
+    }
+    return password;
+}
+
 /** also from kgpgme.cpp, seems to clear password from mem */
 void GpgContext::clearPasswordCache()
 {
@@ -548,45 +1595,81 @@ int GpgContext::checkErr(gpgme_error_t err) const
     return err;
 }
 
+/** Show a messagebox in the gui thread, worker contexts
+ *  only remember the message for lastError()
+ */
+void GpgContext::showError(const QString &title, const QString &text)
+{
+    if (mMaster) {
+        qDebug() << "[Error " << title << "]" << text;
+        mLastError = text;
+    } else {
+        QMessageBox::critical(0, title, text);
+    }
+}
+
+QString GpgContext::lastError() const
+{
+    return mLastError;
+}
+
 QString GpgContext::gpgErrString(gpgme_error_t err) {
     return QString::fromUtf8(gpgme_strerror(err));
 }
 
-/** export private key, TODO errohandling, e.g. like in seahorse (seahorse-gpg-op.c) **/
-
-void GpgContext::exportSecretKey(QString uid, QByteArray *outBuffer)
+/** Export the secret key of uid followed by its public key, gpg
+ *  runs in a GpgProcess, so the gui stays responsive and the export
+ *  can be canceled
+ */
+bool GpgContext::exportSecretKey(QString uid, QByteArray *outBuffer)
 {
-    qDebug() << *outBuffer;
-    // export private key to outBuffer
     QStringList arguments;
     arguments << "--armor" << "--export-secret-key" << uid;
-    QByteArray *err = new QByteArray();
-    executeGpgCommand(arguments, outBuffer, err);
+
+    GpgProcess gpg(gpgBin, gpgKeys);
+    QEventLoop loop;
+    connect(&gpg, SIGNAL(signalFinished(bool)), &loop, SLOT(quit()));
+    QProgressDialog *progress = 0;
+    if (!mMaster) {
+        progress = new QProgressDialog(tr("Exporting secret key..."), tr("Cancel"), 0, 0, QApplication::activeWindow());
+        progress->setWindowModality(Qt::WindowModal);
+        progress->setMinimumDuration(500);
+        connect(progress, SIGNAL(canceled()), &gpg, SLOT(cancel()));
+    }
+    gpg.start(arguments);
+    if (gpg.isRunning()) {
+        loop.exec();
+    }
+    delete progress;
+
+    if (!gpg.success()) {
+        if (!gpg.isCanceled()) {
+            showError(tr("Export error"), gpg.errorString());
+        }
+        return false;
+    }
+    *outBuffer = gpg.readAllOutput();
 
     // append public key to outBuffer
-    QByteArray *pubKey = new QByteArray();
+    QByteArray pubKey;
     QStringList keyList;
     keyList.append(uid);
-    exportKeys(&keyList,pubKey);
-    outBuffer->append(*pubKey);
+    exportKeys(&keyList, &pubKey);
+    outBuffer->append(pubKey);
+    return true;
 }
 
-/** return type should be gpgme_error_t*/
-void GpgContext::executeGpgCommand(QStringList arguments, QByteArray *stdOut, QByteArray *stdErr)
+/** Run gpg and wait for it, the output is read while gpg
+ *  runs, so it can't block on a full pipe
+ */
+void GpgContext::executeGpgCommand(QStringList arguments, QByteArray *stdOut, QByteArray *stdErr, const QByteArray &stdIn)
 {
-    QStringList args;
-    args << "--homedir" << gpgKeys << "--batch" << arguments;
-
-    qDebug() << args;
-    QProcess gpg;
-  //  qDebug() << "engine->file_name" << engine->file_name;
-
-    gpg.start(gpgBin, args);
+    GpgProcess gpg(gpgBin, gpgKeys);
+    gpg.start(arguments, stdIn);
     gpg.waitForFinished();
 
-    *stdOut = gpg.readAllStandardOutput();
-    *stdErr = gpg.readAllStandardError();
-    qDebug() << *stdOut;
+    *stdOut = gpg.readAllOutput();
+    *stdErr = gpg.log();
 }
 
 /***
@@ -603,11 +1686,12 @@ gpgme_signature_t GpgContext::verify(QByteArray inBuffer) {
     gpgme_signature_t sign;
     gpgme_verify_result_t result;
 
-    err = gpgme_data_new_from_mem(&in, inBuffer.data(), inBuffer.size(), 1);
+    err = newDataFromBuffer(&in, inBuffer);
     checkErr(err);
 
     err = gpgme_op_verify (mCtx, in, NULL, in);
     error = checkErr(err);
+    gpgme_data_release(in);
 
     if (error != 0) {
         return NULL;
@@ -618,59 +1702,31 @@ gpgme_signature_t GpgContext::verify(QByteArray inBuffer) {
     return sign;
 }
 
-/***
-  * return type should contain:
-  * -> list of sigs
-  * -> valid
-  * -> decrypted message
-  */
-//void GpgContext::decryptVerify(QByteArray in) {
-
-/*    gpgme_error_t err;
-    gpgme_data_t in, out;
-
-    gpgme_decrypt_result_t decrypt_result;
-    gpgme_verify_result_t verify_result;
-
-    err = gpgme_op_decrypt_verify (mCtx, in, out);
-    decrypt_result = gpgme_op_decrypt_result (mCtx);
-
-    verify_result = gpgme_op_verify_result (mCtx);
- */
-//}
-
 bool GpgContext::sign(QStringList *uidList, const QByteArray &inBuffer, QByteArray *outBuffer ) {
 
     gpgme_error_t err;
     gpgme_data_t in, out;
+    QBuffer outDevice;
     gpgme_sign_result_t result;
 
     if (uidList->count() == 0) {
-        QMessageBox::critical(0, tr("Key Selection"), tr("No Private Key Selected"));
+        showError(tr("Key Selection"), tr("No Private Key Selected"));
         return false;
     }
 
     // at start or end?
     gpgme_signers_clear(mCtx);
 
-    //gpgme_encrypt_result_t e_result;
-    gpgme_key_t signers[uidList->count()+1];
-
-
-    // TODO: do we really need array? adding one key in loop should be ok
+    // the signers are referenced by the context, the key cache keeps its own reference
     for (int i = 0; i < uidList->count(); i++) {
-        // the last 0 is for public keys, 1 would return private keys
-        gpgme_op_keylist_start(mCtx, uidList->at(i).toAscii().constData(), 0);
-        gpgme_op_keylist_next(mCtx, &signers[i]);
-        gpgme_op_keylist_end(mCtx);
-
-        err = gpgme_signers_add (mCtx, signers[i]);
+        err = gpgme_signers_add (mCtx, cachedKey(uidList->at(i)));
         checkErr(err);
     }
 
-     err = gpgme_data_new_from_mem(&in, inBuffer.data(), inBuffer.size(), 1);
+     err = newDataFromBuffer(&in, inBuffer);
      checkErr(err);
-     err = gpgme_data_new (&out);
+     // the clearsigned text, dash escaped, and the armored signature
+     err = newDataToBuffer(&out, &outDevice, outBuffer, inBuffer.size() + inBuffer.size() / 16 + 4096);
      checkErr(err);
 
      /*
@@ -689,21 +1745,21 @@ bool GpgContext::sign(QStringList *uidList, const QByteArray &inBuffer, QByteArr
      err = gpgme_op_sign (mCtx, in, out, GPGME_SIG_MODE_CLEAR);
      checkErr (err);
 
+     gpgme_data_release(in);
+     gpgme_data_release(out);
+
      if (err == GPG_ERR_CANCELED) {
+         outBuffer->resize(0);
          return false;
      }
 
      if (err != GPG_ERR_NO_ERROR) {
-         QMessageBox::critical(0, tr("Error signing:"), QString::fromUtf8(gpgme_strerror(err)));
+         outBuffer->resize(0);
+         showError(tr("Error signing:"), QString::fromUtf8(gpgme_strerror(err)));
          return false;
      }
 
      result = gpgme_op_sign_result (mCtx);
-     err = readToBuffer(out, outBuffer);
-     checkErr (err);
-
-     gpgme_data_release(in);
-     gpgme_data_release(out);
 
      if (! settings.value("general/rememberPassword").toBool()) {
          clearPasswordCache();
@@ -755,43 +1811,378 @@ QString GpgContext::beautifyFingerprint(QString fingerprint)
 }
 
 void GpgContext::slotRefreshKeyList() {
-    mKeyList = this->listKeys();
+    // a listing still running in the job pool is older than this one
+    mKeyListJob = 0;
+    GpgKeyStore *store = new GpgKeyStore();
+    listKeys(store);
+    setKeySnapshot(store, ringStamps());
+    emit signalKeyListRefreshed();
 }
 
-/**
- * note: privkey status is not returned
+/** List the keyring in the job pool, the snapshot is
+ *  replaced when the job is done
  */
-GpgKey GpgContext::getKeyByFpr(QString fpr) {
+void GpgContext::slotRefreshKeyListAsync() {
+    mKeyListJob = listKeysAsync();
+    mKeyListJobStale = false;
+    mKeyListJobStamps = ringStamps();
+    connect(mKeyListJob, SIGNAL(signalFinished(GpgME::GpgJob*)), this, SLOT(slotKeyListJobFinished(GpgME::GpgJob*)));
+}
+
+void GpgContext::slotKeyListJobFinished(GpgME::GpgJob *job) {
+    job->deleteLater();
+    if (job != mKeyListJob) {
+        return;
+    }
+    mKeyListJob = 0;
+    if (mKeyListJobStale) {
+        slotRefreshKeyListAsync();
+        return;
+    }
+
+    GpgKeyList keys = job->keyList();
+    GpgKeyStore *store = new GpgKeyStore();
+    store->reserve(keys.size());
+    foreach (const GpgKey &key, keys) {
+        store->insert(key);
+    }
+    setKeySnapshot(store, mKeyListJobStamps);
+    emit signalKeyListRefreshed();
+
+    // changes by other programs while gpg was listing
+    if (ringStamps() != mRingStamps) {
+        mKeyDBTimer.start();
+    }
+}
+
+/** Replace the snapshot by store, stamps are the
+ *  ringStamps() the keys were listed at
+ */
+void GpgContext::setKeySnapshot(GpgKeyStore *store, const QStringList &stamps) {
+    mKeySnapshot = QSharedPointer<const GpgKeyStore>(store);
+    mKeySearchIndex.clear();
+    mKeySnapshotVersion++;
+    mRingStamps = stamps;
+}
+
+/** Patch the keys with the fingerprints fprs into
+ *  a copy of the snapshot
+ */
+void GpgContext::slotUpdateKeys(QStringList fprs) {
+    if (!mKeySnapshot) {
+        slotRefreshKeyList();
+        return;
+    }
+    if (mKeyListJob) {
+        // the running listing may have missed the change, there is
+        // nothing to patch yet
+        mKeyListJobStale = true;
+        return;
+    }
+    fprs.removeDuplicates();
+
+    // the unchanged keys are shared with the old snapshot until the store detaches
+    GpgKeyStore *store = new GpgKeyStore(*mKeySnapshot);
+    updateKeys(store, fprs);
+    setKeySnapshot(store, ringStamps());
+    emit signalKeysUpdated(fprs);
+}
 
-    //GpgKeyList list = this->listKeys();
-    foreach  (GpgKey key, mKeyList) {
-        if(key.fpr == fpr) {
-            return key;
+/** Watch the keydb directory and the keyrings in it, gpg
+ *  replaces the keyrings by renaming, so the files are added again
+ *  after every change
+ */
+void GpgContext::watchKeyDB() {
+    if (!QDir(gpgKeys).exists()) {
+        return;
+    }
+    if (!mKeyDBWatcher.directories().contains(gpgKeys)) {
+        mKeyDBWatcher.addPath(gpgKeys);
+    }
+    QStringList rings;
+    rings << "pubring.gpg" << "pubring.kbx" << "secring.gpg" << "private-keys-v1.d";
+    foreach (QString ring, rings) {
+        QString path = gpgKeys + "/" + ring;
+        if (QFileInfo(path).exists() && !mKeyDBWatcher.files().contains(path)
+                && !mKeyDBWatcher.directories().contains(path)) {
+            mKeyDBWatcher.addPath(path);
         }
     }
+}
 
-    return GpgKey();
+/** Size and modification time of the public and secret
+ *  keyrings, for the public keys at index 0. For the key directory
+ *  of gpg 2.1 these are the sum and the newest of its key files
+ */
+QStringList GpgContext::ringStamps() const {
+    QStringList publicRings, secretRings;
+    publicRings << "pubring.gpg" << "pubring.kbx";
+    secretRings << "secring.gpg" << "private-keys-v1.d";
+
+    QStringList stamps;
+    foreach (QStringList rings, QList<QStringList>() << publicRings << secretRings) {
+        QString stamp;
+        foreach (QString ring, rings) {
+            QFileInfo info(gpgKeys + "/" + ring);
+            if (!info.exists()) {
+                continue;
+            }
+            qint64 size = info.size();
+            uint modified = info.lastModified().toTime_t();
+            if (info.isDir()) {
+                foreach (QFileInfo keyFile, QDir(info.filePath()).entryInfoList(QDir::Files)) {
+                    size += keyFile.size();
+                    modified = qMax(modified, keyFile.lastModified().toTime_t());
+                }
+            }
+            stamp += QString("%1:%2:%3;").arg(ring).arg(size).arg(modified);
+        }
+        stamps << stamp;
+    }
+    return stamps;
 }
 
-/**
- * note: privkey status is not returned
+/** Called some time after the keydb changed on disk. Changes
+ *  done by this program are already in the snapshot, for other changes
+ *  the keyring is scanned in the job pool and only keys which differ
+ *  from the snapshot are listed again
  */
-GpgKey GpgContext::getKeyById(QString id) {
+void GpgContext::slotCheckKeyDB() {
+    watchKeyDB();
+
+    QStringList stamps = ringStamps();
+    if (stamps == mRingStamps || !mKeySnapshot || mKeyListJob || mKeyDBScanJob) {
+        return;
+    }
+    mRingStamps = stamps;
+
+    mKeyDBScanJob = new GpgJob(this, GpgJob::ScanKeyDB);
+    connect(mKeyDBScanJob, SIGNAL(signalFinished(GpgME::GpgJob*)), this, SLOT(slotKeyDBScanFinished(GpgME::GpgJob*)));
+    startJob(mKeyDBScanJob);
+}
+
+void GpgContext::slotKeyDBScanFinished(GpgME::GpgJob *job) {
+    job->deleteLater();
+    if (job != mKeyDBScanJob) {
+        return;
+    }
+    mKeyDBScanJob = 0;
+
+    // a listing started meanwhile sees the changes anyway
+    if (job->success() && mKeySnapshot && !mKeyListJob) {
+        QHash<QString, QString> states = job->keyStates();
+        QStringList changed;
+        GpgKeyList keys = mKeySnapshot->keys();
+        foreach (GpgKey key, keys) {
+            QString fpr = key.fpr.toUpper();
+            if (!states.contains(fpr)) {
+                // deleted
+                changed << fpr;
+            } else if (states.take(fpr) != keyState(key)) {
+                changed << fpr;
+            }
+        }
+        // the remaining ones are new
+        changed << states.keys();
+
+        if (!changed.isEmpty()) {
+            emit signalKeysChanged(changed);
+        }
+    }
+
+    // changes while gpg was listing
+    if (ringStamps() != mRingStamps) {
+        mKeyDBTimer.start();
+    }
+}
+
+/** Subkeys and uids of key with their validity and expiry,
+ *  comparable with the states returned by scanKeyDB()
+ */
+QString GpgContext::keyState(const GpgKey &key) {
+    return key.privkey ? key.state + "|sec" : key.state;
+}
 
-    //GpgKeyList list = this->listKeys();
-    foreach  (GpgKey key, mKeyList) {
-        if(key.id == id) {
-            return key;
+/** Validity of a --with-colons record, as kept in the key state
+ */
+static QString colonValidity(const QByteArray &field) {
+    return (field == "r" || field == "e") ? QString(field) : QString("-");
+}
+
+/** Undo the \xHH escapes of a --with-colons field
+ */
+static QByteArray colonUnescape(const QByteArray &field) {
+    QByteArray result;
+    for (int i = 0; i < field.size(); i++) {
+        if (field.at(i) == '\\' && i + 3 < field.size() && field.at(i + 1) == 'x') {
+            bool ok;
+            char c = (char)field.mid(i + 2, 2).toInt(&ok, 16);
+            if (ok) {
+                result.append(c);
+                i += 3;
+                continue;
+            }
+        }
+        result.append(field.at(i));
+    }
+    return result;
+}
+
+/** Primary fingerprints of all keys in the keyring, mapped to
+ *  their state as built by toGpgKey(), listed with a single gpg
+ *  call. Runs in the job pool, see GpgJob::ScanKeyDB
+ */
+QHash<QString, QString> GpgContext::scanKeyDB(bool secret) {
+    QByteArray stdOut, stdErr;
+    QStringList args;
+    args << "--with-colons" << "--fixed-list-mode" << "--fingerprint"
+         << (secret ? "--list-secret-keys" : "--list-keys");
+    executeGpgCommand(args, &stdOut, &stdErr);
+
+    QHash<QString, QString> keys;
+    QString fpr, state;
+    bool primaryFpr = false;
+    foreach (QByteArray line, stdOut.split('\n')) {
+        QList<QByteArray> fields = line.split(':');
+        if (fields.size() < 10) {
+            continue;
+        }
+        QByteArray type = fields.at(0);
+        if (type == "pub" || type == "sec") {
+            if (!fpr.isEmpty()) {
+                keys.insert(fpr, state);
+            }
+            fpr.clear();
+            state.clear();
+            primaryFpr = true;
+        } else if (type == "sub" || type == "ssb") {
+            // following fpr records belong to the subkey
+            primaryFpr = false;
+        }
+
+        if (type == "pub" || type == "sec" || type == "sub" || type == "ssb") {
+            // keyid:validity:expiry, the expiry is in seconds with --fixed-list-mode
+            state += QString("%1:%2:%3;").arg(QString(fields.at(4))).arg(colonValidity(fields.at(1)))
+                     .arg(fields.at(6).toLong());
+        } else if (type == "fpr" && primaryFpr) {
+            fpr = QString(fields.at(9)).toUpper();
+            primaryFpr = false;
+        } else if (type == "uid") {
+            state += QString("%1:%2;").arg(fields.at(1) == "r" ? "r" : "-")
+                     .arg(QString::fromUtf8(colonUnescape(fields.at(9))));
         }
     }
+    if (!fpr.isEmpty()) {
+        keys.insert(fpr, state);
+    }
+    return keys;
+}
+
+QSharedPointer<const GpgKeyStore> GpgContext::keySnapshot() const {
+    return mKeySnapshot;
+}
+
+QSharedPointer<const KeySearchIndex> GpgContext::keySearchIndex() {
+    if (!mKeySearchIndex && mKeySnapshot) {
+        mKeySearchIndex = QSharedPointer<const KeySearchIndex>(new KeySearchIndex(*mKeySnapshot));
+    }
+    return mKeySearchIndex;
+}
+
+int GpgContext::keySnapshotVersion() const {
+    return mKeySnapshotVersion;
+}
+
+bool GpgContext::keyListPending() const {
+    return mKeyListJob != 0;
+}
+
+int GpgContext::keyListingCount() const {
+    return mKeyListingCount;
+}
+
+/** Look up uid in the key cache, list the key from
+ *  the keyring on a miss
+ */
+gpgme_key_t GpgContext::cachedKey(const QString &uid)
+{
+    // worker contexts learn about keydb changes from the version counter of the master
+    if (mKeyCacheVersion != sKeyDBVersion) {
+        slotClearKeyCache();
+    }
+
+    gpgme_key_t key = mKeyCache.value(uid, 0);
+    if (key) {
+        return key;
+    }
+
+    // the last 0 is for public keys, 1 would return private keys
+    gpgme_op_keylist_start(mCtx, uid.toAscii().constData(), 0);
+    if (gpgme_op_keylist_next(mCtx, &key)) {
+        key = 0;
+    }
+    gpgme_op_keylist_end(mCtx);
+
+    // misses are not cached, the key might be imported later
+    if (key) {
+        mKeyCache.insert(uid, key);
+    }
+    return key;
+}
+
+/** Drop all cached key handles
+ */
+void GpgContext::slotClearKeyCache()
+{
+    foreach (gpgme_key_t key, mKeyCache) {
+        gpgme_key_unref(key);
+    }
+    mKeyCache.clear();
 
-    return GpgKey();
+    if (!mMaster) {
+        sKeyDBVersion.ref();
+    }
+    mKeyCacheVersion = sKeyDBVersion;
+}
+
+GpgKey GpgContext::getKeyByFpr(QString fpr) {
+    const GpgKey *key = mKeySnapshot ? mKeySnapshot->findByFpr(fpr) : 0;
+    return key ? *key : GpgKey();
+}
+
+GpgKey GpgContext::getKeyById(QString id) {
+    const GpgKey *key = mKeySnapshot ? mKeySnapshot->findById(id) : 0;
+    return key ? *key : GpgKey();
+}
+
+GpgKeyList GpgContext::getKeysByEmail(QString email) {
+    return mKeySnapshot ? mKeySnapshot->findByEmail(email) : GpgKeyList();
 }
 
 QString GpgContext::getGpgmeVersion() {
      return QString(gpgme_check_version(NULL));
 }
 
+QString GpgContext::progressText(qint64 current, qint64 total, int msecs)
+{
+    const double mb = 1024 * 1024;
+    double seconds = msecs / 1000.0;
+    double throughput = seconds > 0 ? current / seconds : 0;
+
+    QString text;
+    if (total > 0) {
+        text = tr("%1 of %2 MB").arg(current / mb, 0, 'f', 1).arg(total / mb, 0, 'f', 1);
+    } else {
+        text = tr("%1 MB").arg(current / mb, 0, 'f', 1);
+    }
+    text += ", " + tr("%1 MB/s").arg(throughput / mb, 0, 'f', 1);
+    if (total > 0 && throughput > 0 && current < total) {
+        int left = qRound((total - current) / throughput);
+        text += ", " + tr("%1:%2 left").arg(left / 60).arg(left % 60, 2, 10, QChar('0'));
+    }
+    return text;
+}
+
 }
 
 
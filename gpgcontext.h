@@ -23,6 +23,8 @@
 #define __SGPGMEPP_CONTEXT_H__
 
 #include "gpgconstants.h"
+#include "gpgkeystore.h"
+#include "keysearchindex.h"
 #include <locale.h>
 #include <errno.h>
 #include <gpgme.h>
@@ -37,31 +39,31 @@ class QByteArray;
 class QString;
 QT_END_NAMESPACE
 
-class GpgKey
+class GpgImportedKey
 {
 public:
-    GpgKey() {
-        privkey = false;
-    }
-    QString id;
-    QString name;
-    QString email;
     QString fpr;
-    bool privkey;
-    bool expired;
-    bool revoked;
+    int importStatus;
 };
 
-typedef QLinkedList< GpgKey > GpgKeyList;
+typedef QLinkedList< GpgImportedKey > GpgImportedKeyList;
 
-class GpgImportedKey
+/**
+ * @brief Result for one file of GpgContext::multiFile()
+ */
+class GpgFileResult
 {
 public:
-    QString fpr;
-    int importStatus;
+    GpgFileResult() {
+        success = false;
+    }
+
+    QString fileName;
+    bool success;
+    QString status; /** the error, or the signer of a good signature */
 };
 
-typedef QLinkedList< GpgImportedKey > GpgImportedKeyList;
+typedef QList< GpgFileResult > GpgFileResultList;
 
 class GpgImportInformation
 {
@@ -82,6 +84,27 @@ public:
         not_imported = 0;
     }
 
+    /**
+     * @details Add the result of another import, e.g. of the next chunk
+     * of a large keyring.
+     */
+    void add(const GpgImportInformation &other) {
+        considered += other.considered;
+        no_user_id += other.no_user_id;
+        imported += other.imported;
+        imported_rsa += other.imported_rsa;
+        unchanged += other.unchanged;
+        new_user_ids += other.new_user_ids;
+        new_sub_keys += other.new_sub_keys;
+        new_signatures += other.new_signatures;
+        new_revocations += other.new_revocations;
+        secret_read += other.secret_read;
+        secret_imported += other.secret_imported;
+        secret_unchanged += other.secret_unchanged;
+        not_imported += other.not_imported;
+        importedKeys += other.importedKeys;
+    }
+
     int considered;
     int no_user_id;
     int imported;
@@ -101,26 +124,171 @@ public:
 namespace GpgME
 {
 
+class GpgJob;
+class GpgProcess;
+
 class GpgContext : public QObject
 {
     Q_OBJECT
 
 public:
-    GpgContext(); // Constructor
+    enum MultiFileOperation {
+        EncryptFiles,
+        DecryptFiles,
+        VerifyFiles
+    };
+
+    /**
+     * @param keyDir The gpg home directory, empty for the keydb in the
+     * application path. Tests and benchmarks pass an isolated keydb.
+     * @param deferKeyList List the keyring in the job pool once the event loop
+     * runs, instead of in the constructor. Until then keySnapshot() is empty
+     * and keyListPending() is true, signalKeyListRefreshed is emitted when the
+     * keys are there.
+     */
+    explicit GpgContext(const QString &keyDir = QString(), bool deferKeyList = false);
+    /**
+     * @details Create a worker context for another thread. gpgme contexts must not
+     * be shared between threads, so every thread needs its own context. Passphrase
+     * requests are forwarded to the gui thread of master, changes to the keydb are
+     * signaled by master.
+     *
+     * @param master The context living in the gui thread
+     */
+    explicit GpgContext(GpgContext *master);
     ~GpgContext(); // Destructor
+
+    /**
+     * @details Run job in the job pool. Every pool thread uses its own worker
+     * context, signalFinished of the job is delivered to the thread the job was
+     * created in.
+     */
+    void startJob(GpgJob *job);
+    /**
+     * @details Convenience functions creating a job, it is started when control
+     * returns to the event loop. Connect to signalFinished of the returned job.
+     */
+    GpgJob *encryptAsync(const QStringList &uidList, const QByteArray &inBuffer);
+    GpgJob *decryptAsync(const QByteArray &inBuffer);
+    GpgJob *signAsync(const QStringList &uidList, const QByteArray &inBuffer);
+    GpgJob *importKeyAsync(const QByteArray &inBuffer);
+    /**
+     * @details multiFile() in the job pool, the results are in
+     * GpgJob::fileResults(). Canceling the job kills the running gpg.
+     */
+    GpgJob *multiFileAsync(MultiFileOperation operation, const QStringList &fileNames,
+                           const QStringList &uidList = QStringList(), bool armor = false);
+    GpgJob *listKeysAsync();
+
     GpgImportInformation importKey(QByteArray inBuffer);
+    /**
+     * @details Import a keyring file of any size. Binary keyrings are read and
+     * imported in chunks of whole keys, signalKeysChanged is emitted once
+     * after the last chunk. A progress dialog shows the keys read so far and
+     * allows to cancel between chunks. Armored files are imported in one stream.
+     *
+     * @param skipUnchanged Don't pass keys to gpg, which are in the keyring
+     * and came in unchanged with an earlier import of this mode. They are
+     * counted as unchanged. Only binary keyrings are filtered.
+     * @return The statistics of all imported chunks
+     */
+    GpgImportInformation importKeyFile(QIODevice *inFile, bool skipUnchanged = false);
+    /**
+     * @details Export the keys in uidList, armored. All keys are exported by
+     * a few gpg runs instead of one run per key.
+     */
     bool exportKeys(QStringList *uidList, QByteArray *outBuffer);
+    /**
+     * @details Streaming counterpart of exportKeys(), for large exports.
+     *
+     * @param uidList The keys to export, 0 exports the whole keyring
+     */
+    bool exportKeysFile(QStringList *uidList, QIODevice *outFile);
     void generateKey(QString *params);
+    /**
+     * @details Generate a key by running gpg directly, so the generation reports
+     * its progress and GpgProcess::cancel() stops it at once. signalKeysChanged
+     * is emitted for the new key. The caller owns the returned process.
+     *
+     * @param params Parameters in the format of generateKey()
+     */
+    GpgProcess *generateKeyAsync(const QString &params);
     GpgKeyList listKeys();
+    /**
+     * @details Delete public and secret keys of uidList. A progress dialog
+     * allows to cancel the deletion of many keys, signalKeysChanged is
+     * emitted once for all keys.
+     */
     void deleteKeys(QStringList *uidList);
+    /**
+     * @details Encrypt inBuffer for the keys in uidList.
+     *
+     * @param armor Write ASCII armor, otherwise binary OpenPGP data
+     */
     bool encrypt(QStringList *uidList, const QByteArray &inBuffer,
-                 QByteArray *outBuffer);
+                 QByteArray *outBuffer, bool armor = true);
+    /**
+     * @details Sign inBuffer with the keys in signerList and encrypt it for the
+     * keys in uidList with a single gpg invocation.
+     */
+    bool encryptSign(QStringList *uidList, QStringList *signerList, const QByteArray &inBuffer,
+                     QByteArray *outBuffer, bool armor = true);
     bool decrypt(const QByteArray &inBuffer, QByteArray *outBuffer);
+    /**
+     * @details Encrypt the content of inFile for the keys in uidList and write the
+     * result to outFile. Both devices are streamed through gpg, so memory usage
+     * doesn't depend on the size of the file.
+     *
+     * @param uidList List of key ids to encrypt for
+     * @param inFile Opened, readable device holding the plaintext
+     * @param outFile Opened, writable device taking the ciphertext
+     * @param armor Write ASCII armor instead of the smaller binary format
+     */
+    bool encryptFile(QStringList *uidList, QIODevice *inFile, QIODevice *outFile, bool armor = false);
+    /**
+     * @details Streaming counterpart of encryptSign(), see encryptFile().
+     */
+    bool encryptSignFile(QStringList *uidList, QStringList *signerList, QIODevice *inFile,
+                         QIODevice *outFile, bool armor = false);
+    /**
+     * @details Streaming counterpart of decrypt(), see encryptFile(). Binary and
+     * armored input are both accepted.
+     */
+    bool decryptFile(QIODevice *inFile, QIODevice *outFile);
+    /**
+     * @details Encrypt, decrypt or verify many files with a few gpg processes
+     * (--multifile) instead of one per file, so process startup and keyring
+     * loading are paid once for up to 200 files. Encrypted files get .gpg or
+     * .asc appended, decrypted files are written without it. For decryption
+     * the password is asked once for all files. Blocks until all files are
+     * done, use multiFileAsync() from the gui thread.
+     *
+     * @param uidList Recipients, only used for EncryptFiles
+     * @return One result per file, in the order of fileNames
+     */
+    GpgFileResultList multiFile(MultiFileOperation operation, const QStringList &fileNames,
+                                QStringList *uidList = 0, bool armor = false);
     void clearPasswordCache();
-    void exportSecretKey(QString uid, QByteArray *outBuffer);
+    /**
+     * @details Export secret and public key of uid, armored. A progress dialog
+     * allows to cancel a long export.
+     *
+     * @return false, if gpg failed or the export was canceled
+     */
+    bool exportSecretKey(QString uid, QByteArray *outBuffer);
     gpgme_key_t getKeyDetails(QString uid);
     gpgme_signature_t verify(QByteArray in);
-//    void decryptVerify(QByteArray in);
+    /**
+     * @details Decrypt inBuffer and verify the signatures of the decrypted
+     * message with a single gpg invocation.
+     *
+     * @param signatures Set to the signatures found, 0 if the message wasn't
+     * signed. Like the result of verify(), the list belongs to the context and
+     * is valid until the next operation.
+     * @return true, if decryption succeeded. A bad signature is reported in
+     * the status of the signature, not here.
+     */
+    bool decryptVerify(const QByteArray &inBuffer, QByteArray *outBuffer, gpgme_signature_t *signatures);
     bool sign(QStringList *uidList, const QByteArray &inBuffer, QByteArray *outBuffer );
     /**
      * @details If text contains PGP-message, put a linebreak before the message,
@@ -130,11 +298,68 @@ public:
      */
     void preventNoDataErr(QByteArray *in);
 
+    /**
+     * @details Lookups in the keylist of the last refresh, answered by hash
+     * indexes. Subkey fingerprints and ids return their primary key, getKeyById
+     * takes short and long key ids.
+     */
     GpgKey getKeyByFpr(QString fpr);
     GpgKey getKeyById(QString id);
+    GpgKeyList getKeysByEmail(QString email);
+
+    /**
+     * @details The keys of the keyring, listed once per keydb change and shared
+     * by all views. The snapshot is never modified, a refresh replaces it with
+     * a new one and emits signalKeyListRefreshed.
+     */
+    QSharedPointer<const GpgKeyStore> keySnapshot() const;
+    /**
+     * @details Search index over keySnapshot(), built on first use and shared
+     * until the next snapshot.
+     */
+    QSharedPointer<const KeySearchIndex> keySearchIndex();
+    /**
+     * @details Increased with every new snapshot, starting at 1.
+     */
+    int keySnapshotVersion() const;
+    /**
+     * @details A listing in the job pool is running, the snapshot is not
+     * complete yet.
+     */
+    bool keyListPending() const;
+    /**
+     * @details Number of full keyring listings done for this context, in its
+     * own thread or by a job of the pool. Every listing runs gpg twice
+     * (public and secret keys).
+     */
+    int keyListingCount() const;
 
     static QString gpgErrString(gpgme_error_t err);
     static QString getGpgmeVersion();
+    /**
+     * @details Text for a progress display with the bytes done, the throughput
+     * and the estimated time left, e.g. "12.0 of 100.0 MB, 20.5 MB/s, 0:04 left".
+     *
+     * @param total 0, if unknown, then no time left is estimated
+     * @param msecs Time since the operation started
+     */
+    static QString progressText(qint64 current, qint64 total, int msecs);
+
+    /**
+     * @details Abort the running operation of this context, safe to call from
+     * any thread. Streamed operations (encryptFile(), decryptFile(), ...) stop
+     * at the next read or write of gpg and fail. The request stays until
+     * resetCancel() is called.
+     */
+    void cancel();
+    bool isCanceled() const;
+    void resetCancel();
+
+    /**
+     * @details Message of the last error of a worker context, on the master
+     * context errors are shown in a messagebox instead.
+     */
+    QString lastError() const;
 
     /**
      * @brief
@@ -148,20 +373,114 @@ public:
     QString beautifyFingerprint(QString fingerprint);
 
 signals:
+    /**
+     * @details The keydb changed in an unknown way, the whole keyring is listed
+     * again.
+     */
     void signalKeyDBChanged();
+    /**
+     * @details The keys with the primary fingerprints fprs were added, changed or
+     * deleted. Only these keys are listed again.
+     */
+    void signalKeysChanged(QStringList fprs);
+    /**
+     * @details A new key snapshot is available, emitted after the keyring was
+     * listed in reaction to signalKeyDBChanged.
+     */
+    void signalKeyListRefreshed();
+    /**
+     * @details A new key snapshot is available, which differs from the previous
+     * one only in the keys with the primary fingerprints fprs. Keys missing in the
+     * snapshot were deleted.
+     */
+    void signalKeysUpdated(QStringList fprs);
+    /**
+     * @details Progress of the running operation. For streamed operations current
+     * and total are bytes of the input device, otherwise the units of the
+     * PROGRESS status of gpg. total is 0 if unknown. Emitted in the thread
+     * running the operation.
+     */
+    void signalProgress(qint64 current, qint64 total);
 
 private slots:
     void slotRefreshKeyList();
+    void slotRefreshKeyListAsync();
+    void slotKeyListJobFinished(GpgME::GpgJob *job);
+    void slotUpdateKeys(QStringList fprs);
+    void slotCheckKeyDB();
+    void slotKeyDBScanFinished(GpgME::GpgJob *job);
+    void slotClearKeyCache();
+    void slotStartJob(GpgME::GpgJob *job);
+    bool slotRequestPassphrase(QString gpgHint, bool lastWasBad);
+    QByteArray slotWorkerPassphrase(QString gpgHint, bool lastWasBad);
+    void slotKeyGenStatus(const QByteArray &keyword, const QByteArray &arguments);
 
 private:
+    friend class GpgJob;
+
+    void setupContext();
+    void showError(const QString &title, const QString &text);
+    /**
+     * @details Resolve uid to a key handle. Handles are cached until the keydb
+     * changes, so repeated operations for the same keys skip the keyring scan.
+     * The returned handle is owned by the cache, don't unref it.
+     *
+     * @param uid Key id or fingerprint
+     * @return The key or 0, if no key matches uid
+     */
+    gpgme_key_t cachedKey(const QString &uid);
+
     gpgme_ctx_t mCtx;
+    GpgContext *mMaster; /** the master context of a worker context, 0 for the master itself */
+    QString mLastError;
+    QThreadPool mJobPool;
     gpgme_data_t in, out;
     gpgme_error_t err;
-    gpgme_error_t readToBuffer(gpgme_data_t in, QByteArray *outBuffer);
+    bool checkKeySelection(QStringList *uidList, QStringList *signerList);
+    gpgme_error_t encryptData(QStringList *uidList, QStringList *signerList, gpgme_data_t in, gpgme_data_t out, bool armor);
+    gpgme_error_t decryptData(gpgme_data_t in, gpgme_data_t out, bool verify);
+    gpgme_error_t newDataFromDevice(gpgme_data_t *data, QIODevice *device);
+    gpgme_error_t newDataFromBuffer(gpgme_data_t *data, const QByteArray &inBuffer);
+    gpgme_error_t newDataToBuffer(gpgme_data_t *data, QBuffer *device, QByteArray *outBuffer, qint64 expectedSize);
+    gpgme_error_t exportKeysData(QStringList *uidList, gpgme_data_t out);
+    GpgImportInformation importData(gpgme_data_t in, QStringList *changedFprs = 0);
+    void loadImportDigests();
+    void saveImportDigests();
+
+    static ssize_t deviceReadCb(void *handle, void *buffer, size_t size);
+    static ssize_t deviceWriteCb(void *handle, const void *buffer, size_t size);
+    static off_t deviceSeekCb(void *handle, off_t offset, int whence);
+    static void deviceReleaseCb(void *handle);
+    static void progressCb(void *opaque, const char *what, int type, int current, int total);
+    QAtomicInt mCancelRequested;
+    int mOpenDevices; /** input devices wrapped by newDataFromDevice(), they report the progress */
     QByteArray mPasswordCache;
     QSettings settings;
     bool debug;
-    GpgKeyList mKeyList;
+    QSharedPointer<const GpgKeyStore> mKeySnapshot; /** keys of the last slotRefreshKeyList() */
+    QSharedPointer<const KeySearchIndex> mKeySearchIndex; /** index of mKeySnapshot, 0 until used */
+    int mKeySnapshotVersion;
+    GpgJob *mKeyListJob; /** the running listing of slotRefreshKeyListAsync(), 0 if none */
+    bool mKeyListJobStale; /** keys changed while mKeyListJob runs, list again */
+    QStringList mKeyListJobStamps; /** ringStamps() when mKeyListJob started */
+    QAtomicInt mKeyListingCount;
+    QHash<QString, QByteArray> mImportDigests; /** fpr to digest of the key block imported last */
+    bool mImportDigestsLoaded;
+    QFileSystemWatcher mKeyDBWatcher;
+    QTimer mKeyDBTimer; /** collects the change notifications of one gpg run */
+    QStringList mRingStamps; /** ringStamps() at the time of the last snapshot */
+    GpgJob *mKeyDBScanJob; /** the running scan of slotCheckKeyDB(), 0 if none */
+    void updateKeys(GpgKeyStore *store, const QStringList &fprs);
+    GpgKey toGpgKey(gpgme_key_t key);
+    void watchKeyDB();
+    QStringList ringStamps() const;
+    QHash<QString, QString> scanKeyDB(bool secret);
+    static QString keyState(const GpgKey &key);
+    void listKeys(GpgKeyStore *store);
+    void setKeySnapshot(GpgKeyStore *store, const QStringList &stamps);
+    QHash<QString, gpgme_key_t> mKeyCache;
+    int mKeyCacheVersion; /** value of sKeyDBVersion mKeyCache was filled at */
+    static QAtomicInt sKeyDBVersion; /** increased by the master on every keydb change */
     int checkErr(gpgme_error_t err) const;
     int checkErr(gpgme_error_t err, QString comment) const;
 
@@ -172,9 +491,14 @@ private:
                              const char *passphrase_info,
                              int last_was_bad, int fd);
 
+    bool requestPassphrase(const QString &gpgHint, bool lastWasBad);
+    void parseMultiFileStatus(MultiFileOperation operation, const QList<QByteArray> &status,
+                              const QByteArray &log, GpgFileResultList::iterator results,
+                              GpgFileResultList::iterator end);
     void executeGpgCommand(QStringList arguments,
                            QByteArray *stdOut,
-                           QByteArray *stdErr);
+                           QByteArray *stdErr,
+                           const QByteArray &stdIn = QByteArray());
     QString gpgBin;
     QString gpgKeys;
 };
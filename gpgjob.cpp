@@ -0,0 +1,294 @@
+/*
+ *      gpgjob.cpp
+ *
+ *      Copyright 2008 gpg4usb-team <gpg4usb@cpunk.de>
+ *
+ *      This file is part of gpg4usb.
+ *
+ *      Gpg4usb is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      Gpg4usb is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with gpg4usb.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "gpgjob.h"
+
+namespace GpgME
+{
+
+/** one worker context per pool thread, deleted when the thread exits */
+static QThreadStorage<GpgContext *> workerContexts;
+
+GpgJob::GpgJob(GpgContext *ctx, Operation operation)
+{
+    qRegisterMetaType<GpgME::GpgJob*>("GpgME::GpgJob*");
+
+    mCtx = ctx;
+    mOperation = operation;
+    mSuccess = false;
+    mArmor = false;
+    mMultiFileOperation = GpgContext::EncryptFiles;
+    mCanceled = false;
+    mRunningCtx = 0;
+
+    // the receiver of signalFinished deletes the job
+    setAutoDelete(false);
+}
+
+void GpgJob::setKeys(const QStringList &uidList)
+{
+    mKeys = uidList;
+}
+
+void GpgJob::setSigners(const QStringList &signerList)
+{
+    mSigners = signerList;
+}
+
+void GpgJob::setInput(const QByteArray &inBuffer)
+{
+    mInput = inBuffer;
+}
+
+void GpgJob::setFiles(const QString &inFileName, const QString &outFileName)
+{
+    mInFileName = inFileName;
+    mOutFileName = outFileName;
+}
+
+void GpgJob::setArmor(bool armor)
+{
+    mArmor = armor;
+}
+
+void GpgJob::setMultiFile(GpgContext::MultiFileOperation operation, const QStringList &fileNames)
+{
+    mMultiFileOperation = operation;
+    mFileNames = fileNames;
+}
+
+GpgJob::Operation GpgJob::operation() const
+{
+    return mOperation;
+}
+
+QStringList GpgJob::keys() const
+{
+    return mKeys;
+}
+
+QString GpgJob::inFileName() const
+{
+    return mInFileName;
+}
+
+QString GpgJob::outFileName() const
+{
+    return mOutFileName;
+}
+
+bool GpgJob::success() const
+{
+    return mSuccess;
+}
+
+QString GpgJob::errorString() const
+{
+    return mErrorString;
+}
+
+QByteArray GpgJob::output() const
+{
+    return mOutput;
+}
+
+GpgKeyList GpgJob::keyList() const
+{
+    return mKeyList;
+}
+
+GpgImportInformation GpgJob::importInformation() const
+{
+    return mImportInformation;
+}
+
+QStringList GpgJob::signatureFprs() const
+{
+    return mSignatureFprs;
+}
+
+QList<gpgme_error_t> GpgJob::signatureStatus() const
+{
+    return mSignatureStatus;
+}
+
+GpgFileResultList GpgJob::fileResults() const
+{
+    return mFileResults;
+}
+
+QHash<QString, QString> GpgJob::keyStates() const
+{
+    return mKeyStates;
+}
+
+void GpgJob::cancel()
+{
+    QMutexLocker locker(&mMutex);
+    mCanceled = true;
+    if (mRunningCtx) {
+        mRunningCtx->cancel();
+    }
+}
+
+bool GpgJob::isCanceled() const
+{
+    QMutexLocker locker(&mMutex);
+    return mCanceled;
+}
+
+/** Runs in the pool thread
+ */
+void GpgJob::run()
+{
+    GpgContext *ctx = workerContext();
+
+    {
+        QMutexLocker locker(&mMutex);
+        if (mCanceled) {
+            mErrorString = tr("Canceled");
+            emit signalFinished(this);
+            return;
+        }
+        mRunningCtx = ctx;
+    }
+    connect(ctx, SIGNAL(signalProgress(qint64, qint64)),
+            this, SIGNAL(signalProgress(qint64, qint64)), Qt::DirectConnection);
+
+    switch (mOperation) {
+    case Encrypt:
+        mSuccess = ctx->encrypt(&mKeys, mInput, &mOutput);
+        break;
+    case EncryptSign:
+        mSuccess = ctx->encryptSign(&mKeys, &mSigners, mInput, &mOutput);
+        break;
+    case Decrypt:
+        mSuccess = ctx->decrypt(mInput, &mOutput);
+        break;
+    case DecryptVerify: {
+        gpgme_signature_t sign = 0;
+        mSuccess = ctx->decryptVerify(mInput, &mOutput, &sign);
+        // the result is freed by the next operation of the worker context
+        for (; sign; sign = sign->next) {
+            mSignatureFprs << QString(sign->fpr);
+            mSignatureStatus << sign->status;
+        }
+        break;
+    }
+    case Sign:
+        mSuccess = ctx->sign(&mKeys, mInput, &mOutput);
+        break;
+    case EncryptFile:
+    case EncryptSignFile:
+    case DecryptFile:
+        mSuccess = runFileOperation(ctx);
+        break;
+    case ImportKey:
+        mImportInformation = ctx->importKey(mInput);
+        mSuccess = ctx->lastError().isEmpty();
+        break;
+    case ListKeys:
+        mKeyList = ctx->listKeys();
+        mSuccess = true;
+        break;
+    case MultiFile:
+        mFileResults = ctx->multiFile(mMultiFileOperation, mFileNames, &mKeys, mArmor);
+        mSuccess = !mFileResults.isEmpty();
+        foreach (GpgFileResult result, mFileResults) {
+            mSuccess = mSuccess && result.success;
+        }
+        break;
+    case ScanKeyDB:
+        mKeyStates = ctx->scanKeyDB(false);
+        foreach (QString fpr, ctx->scanKeyDB(true).keys()) {
+            if (mKeyStates.contains(fpr)) {
+                mKeyStates[fpr] += "|sec";
+            }
+        }
+        mSuccess = true;
+        break;
+    }
+
+    disconnect(ctx, SIGNAL(signalProgress(qint64, qint64)), this, SIGNAL(signalProgress(qint64, qint64)));
+    // the worker context outlives the job, only the master remembers passwords
+    ctx->clearPasswordCache();
+    {
+        QMutexLocker locker(&mMutex);
+        mRunningCtx = 0;
+        if (mCanceled) {
+            mSuccess = false;
+            mErrorString = tr("Canceled");
+        }
+    }
+
+    if (!mSuccess && mErrorString.isEmpty()) {
+        mErrorString = ctx->lastError();
+    }
+    emit signalFinished(this);
+}
+
+bool GpgJob::runFileOperation(GpgContext *ctx)
+{
+    QFile inFile(mInFileName);
+    if (!inFile.open(QIODevice::ReadOnly)) {
+        mErrorString = tr("Couldn't Open file: ") + mInFileName;
+        return false;
+    }
+
+    QFile outFile(mOutFileName);
+    if (!outFile.open(QIODevice::WriteOnly)) {
+        mErrorString = tr("Cannot write file %1:\n%2.").arg(mOutFileName).arg(outFile.errorString());
+        return false;
+    }
+
+    bool success;
+    if (mOperation == EncryptFile) {
+        success = ctx->encryptFile(&mKeys, &inFile, &outFile, mArmor);
+    } else if (mOperation == EncryptSignFile) {
+        success = ctx->encryptSignFile(&mKeys, &mSigners, &inFile, &outFile, mArmor);
+    } else {
+        success = ctx->decryptFile(&inFile, &outFile);
+    }
+    inFile.close();
+    outFile.close();
+
+    // don't leave a partially written file behind
+    if (!success) {
+        outFile.remove();
+    }
+    return success;
+}
+
+/** Get the worker context of the current pool thread,
+ *  create it on first use
+ */
+GpgContext *GpgJob::workerContext()
+{
+    if (!workerContexts.hasLocalData() || workerContexts.localData()->mMaster != mCtx) {
+        workerContexts.setLocalData(new GpgContext(mCtx));
+    }
+    GpgContext *ctx = workerContexts.localData();
+    ctx->mLastError.clear();
+    ctx->resetCancel();
+    return ctx;
+}
+
+} // namespace GpgME
@@ -0,0 +1,174 @@
+/*
+ *      gpgjob.h
+ *
+ *      Copyright 2008 gpg4usb-team <gpg4usb@cpunk.de>
+ *
+ *      This file is part of gpg4usb.
+ *
+ *      Gpg4usb is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      Gpg4usb is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with gpg4usb.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef __GPGJOB_H__
+#define __GPGJOB_H__
+
+#include "gpgcontext.h"
+#include <QRunnable>
+
+namespace GpgME
+{
+
+/**
+ * @brief A GpgContext operation running in the job pool of a GpgContext
+ *
+ * @details The operation is executed on the worker context of the pool thread,
+ * so the context of the gui thread is never used concurrently. When done,
+ * signalFinished is delivered to the thread the job was created in. The
+ * receiver owns the job and should deleteLater() it.
+ */
+class GpgJob : public QObject, public QRunnable
+{
+    Q_OBJECT
+
+public:
+    enum Operation {
+        Encrypt,
+        EncryptSign,
+        Decrypt,
+        DecryptVerify,
+        Sign,
+        EncryptFile,
+        EncryptSignFile,
+        DecryptFile,
+        ImportKey,
+        ListKeys,
+        MultiFile,
+        ScanKeyDB
+    };
+
+    /**
+     * @param ctx The master context, whose job pool runs the job
+     * @param operation The operation to run
+     */
+    GpgJob(GpgContext *ctx, Operation operation);
+
+    /**
+     * @details Keys to encrypt for or to sign with.
+     */
+    void setKeys(const QStringList &uidList);
+    /**
+     * @details Keys to sign with for EncryptSign and EncryptSignFile.
+     */
+    void setSigners(const QStringList &signerList);
+    /**
+     * @details Input of Encrypt, EncryptSign, Decrypt, DecryptVerify, Sign and
+     * ImportKey.
+     */
+    void setInput(const QByteArray &inBuffer);
+    /**
+     * @details In- and output file of EncryptFile, EncryptSignFile and DecryptFile.
+     */
+    void setFiles(const QString &inFileName, const QString &outFileName);
+    /**
+     * @details Write ASCII armor for EncryptFile and EncryptSignFile, binary output
+     * is the default.
+     */
+    void setArmor(bool armor);
+    /**
+     * @details Operation and files of MultiFile, see GpgContext::multiFile().
+     */
+    void setMultiFile(GpgContext::MultiFileOperation operation, const QStringList &fileNames);
+
+    Operation operation() const;
+    QStringList keys() const;
+    QString inFileName() const;
+    QString outFileName() const;
+
+    /**
+     * @details Results, valid after signalFinished was emitted.
+     */
+    bool success() const;
+    QString errorString() const;
+    QByteArray output() const;
+    GpgKeyList keyList() const;
+    GpgImportInformation importInformation() const;
+    /**
+     * @details Fingerprints or key ids and status of the signatures found by
+     * DecryptVerify, empty if the message wasn't signed. Copied from the gpgme
+     * result, which belongs to the worker context.
+     */
+    QStringList signatureFprs() const;
+    QList<gpgme_error_t> signatureStatus() const;
+    /**
+     * @details One result per file of MultiFile, success() is true if all
+     * files succeeded.
+     */
+    GpgFileResultList fileResults() const;
+    /**
+     * @details Primary fingerprints of the keyring mapped to the state of
+     * their keys, the result of ScanKeyDB. Used by GpgContext to find keys
+     * changed by other programs.
+     */
+    QHash<QString, QString> keyStates() const;
+
+    bool isCanceled() const;
+
+    void run();
+
+public slots:
+    /**
+     * @details Abort the job, safe to call from any thread. A queued job
+     * doesn't run at all, running file operations stop at once.
+     */
+    void cancel();
+
+signals:
+    void signalFinished(GpgME::GpgJob *job);
+    /**
+     * @details Progress of the running job, see GpgContext::signalProgress().
+     */
+    void signalProgress(qint64 current, qint64 total);
+
+private:
+    GpgContext *workerContext();
+    bool runFileOperation(GpgContext *ctx);
+
+    GpgContext *mCtx; /** The master context */
+    Operation mOperation;
+    QStringList mKeys;
+    QStringList mSigners;
+    QByteArray mInput;
+    QString mInFileName;
+    QString mOutFileName;
+    bool mArmor;
+    GpgContext::MultiFileOperation mMultiFileOperation;
+    QStringList mFileNames;
+
+    bool mSuccess;
+    QString mErrorString;
+    QByteArray mOutput;
+    GpgKeyList mKeyList;
+    GpgImportInformation mImportInformation;
+    QStringList mSignatureFprs;
+    QList<gpgme_error_t> mSignatureStatus;
+    GpgFileResultList mFileResults;
+    QHash<QString, QString> mKeyStates;
+
+    mutable QMutex mMutex; /** guards mCanceled and mRunningCtx */
+    bool mCanceled;
+    GpgContext *mRunningCtx; /** the worker context while the job runs */
+};
+
+} // namespace GpgME
+
+#endif // __GPGJOB_H__
@@ -0,0 +1,191 @@
+/*
+ *      gpgkeystore.cpp
+ *
+ *      Copyright 2008 gpg4usb-team <gpg4usb@cpunk.de>
+ *
+ *      This file is part of gpg4usb.
+ *
+ *      Gpg4usb is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      Gpg4usb is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with gpg4usb.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "gpgkeystore.h"
+
+GpgKeyStore::GpgKeyStore()
+{
+}
+
+void GpgKeyStore::clear()
+{
+    mKeys.clear();
+    mFprIndex.clear();
+    mLongIdIndex.clear();
+    mShortIdIndex.clear();
+    mEmailIndex.clear();
+}
+
+void GpgKeyStore::reserve(int size)
+{
+    mKeys.reserve(size);
+    mFprIndex.reserve(size);
+    mLongIdIndex.reserve(size);
+    mShortIdIndex.reserve(size);
+    mEmailIndex.reserve(size);
+}
+
+void GpgKeyStore::insert(const GpgKey &key)
+{
+    int pos = primaryPosition(key.fpr);
+    if (pos < 0) {
+        pos = mKeys.size();
+        mKeys.append(key);
+    } else {
+        removeFromIndex(pos);
+        mKeys[pos] = key;
+    }
+    addToIndex(pos);
+}
+
+bool GpgKeyStore::remove(const QString &fpr)
+{
+    int pos = primaryPosition(fpr);
+    if (pos < 0) {
+        return false;
+    }
+    removeFromIndex(pos);
+
+    // move the last key into the hole, so no other position changes
+    int last = mKeys.size() - 1;
+    if (pos != last) {
+        removeFromIndex(last);
+        mKeys[pos] = mKeys.at(last);
+        addToIndex(pos);
+    }
+    mKeys.remove(last);
+    return true;
+}
+
+/** position of the key with primary fingerprint fpr, -1 if
+ *  there is none (fpr might belong to a subkey)
+ */
+int GpgKeyStore::primaryPosition(const QString &fpr) const
+{
+    int pos = mFprIndex.value(fpr.toUpper(), -1);
+    if (pos >= 0 && mKeys.at(pos).fpr.compare(fpr, Qt::CaseInsensitive) != 0) {
+        return -1;
+    }
+    return pos;
+}
+
+void GpgKeyStore::addToIndex(int pos)
+{
+    const GpgKey &key = mKeys.at(pos);
+
+    mFprIndex.insert(key.fpr.toUpper(), pos);
+    foreach (QString fpr, key.subkeyFprs) {
+        mFprIndex.insert(fpr.toUpper(), pos);
+    }
+    foreach (QString id, key.subkeyIds) {
+        id = id.toUpper();
+        mLongIdIndex.insert(id, pos);
+        mShortIdIndex.insert(id.right(8), pos);
+    }
+    if (!key.email.isEmpty()) {
+        mEmailIndex.insert(key.email.toLower(), pos);
+    }
+}
+
+void GpgKeyStore::removeFromIndex(int pos)
+{
+    const GpgKey &key = mKeys.at(pos);
+
+    // short ids may collide, only drop entries still pointing to this key
+    QStringList fprs = key.subkeyFprs;
+    fprs << key.fpr;
+    foreach (QString fpr, fprs) {
+        fpr = fpr.toUpper();
+        if (mFprIndex.value(fpr, -1) == pos) {
+            mFprIndex.remove(fpr);
+        }
+    }
+    foreach (QString id, key.subkeyIds) {
+        id = id.toUpper();
+        if (mLongIdIndex.value(id, -1) == pos) {
+            mLongIdIndex.remove(id);
+        }
+        if (mShortIdIndex.value(id.right(8), -1) == pos) {
+            mShortIdIndex.remove(id.right(8));
+        }
+    }
+    if (!key.email.isEmpty()) {
+        mEmailIndex.remove(key.email.toLower(), pos);
+    }
+}
+
+bool GpgKeyStore::markPrivate(const QString &fpr)
+{
+    int pos = mFprIndex.value(fpr.toUpper(), -1);
+    if (pos < 0) {
+        return false;
+    }
+    mKeys[pos].privkey = true;
+    return true;
+}
+
+int GpgKeyStore::size() const
+{
+    return mKeys.size();
+}
+
+const GpgKey &GpgKeyStore::at(int i) const
+{
+    return mKeys.at(i);
+}
+
+int GpgKeyStore::indexOf(const QString &fpr) const
+{
+    return primaryPosition(fpr);
+}
+
+GpgKeyList GpgKeyStore::keys() const
+{
+    return mKeys;
+}
+
+const GpgKey *GpgKeyStore::findByFpr(const QString &fpr) const
+{
+    int pos = mFprIndex.value(fpr.toUpper(), -1);
+    return (pos < 0) ? 0 : &mKeys.at(pos);
+}
+
+const GpgKey *GpgKeyStore::findById(const QString &id) const
+{
+    int pos;
+    if (id.length() <= 8) {
+        pos = mShortIdIndex.value(id.toUpper(), -1);
+    } else {
+        pos = mLongIdIndex.value(id.right(16).toUpper(), -1);
+    }
+    return (pos < 0) ? 0 : &mKeys.at(pos);
+}
+
+GpgKeyList GpgKeyStore::findByEmail(const QString &email) const
+{
+    GpgKeyList result;
+    QList<int> positions = mEmailIndex.values(email.toLower());
+    // QMultiHash returns the most recently inserted first
+    for (int i = positions.size() - 1; i >= 0; i--) {
+        result.append(mKeys.at(positions.at(i)));
+    }
+    return result;
+}
@@ -0,0 +1,129 @@
+/*
+ *      gpgkeystore.h
+ *
+ *      Copyright 2008 gpg4usb-team <gpg4usb@cpunk.de>
+ *
+ *      This file is part of gpg4usb.
+ *
+ *      Gpg4usb is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      Gpg4usb is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with gpg4usb.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef __GPGKEYSTORE_H__
+#define __GPGKEYSTORE_H__
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class GpgKey
+{
+public:
+    GpgKey() {
+        privkey = false;
+        expired = false;
+        revoked = false;
+    }
+    QString id;
+    QString name;
+    QString email;
+    QString fpr;
+    bool privkey;
+    bool expired;
+    bool revoked;
+    QStringList subkeyIds; /** long ids of all subkeys, including the primary key */
+    QStringList subkeyFprs; /** fingerprints of all subkeys, including the primary key */
+    QString state; /** subkeys and uids with validity and expiry, to find changed keys */
+};
+
+typedef QVector< GpgKey > GpgKeyList;
+
+/**
+ * @brief The keys of the keyring, indexed for lookups
+ *
+ * @details Keys are stored in one contiguous list, lookups by fingerprint,
+ * long or short key id and email address are answered by hash indexes.
+ * Ids and fingerprints of subkeys point to their primary key.
+ *
+ * Keys can be replaced and removed in place, so single keys can be updated
+ * without listing the whole keyring again. Removing moves the last key into
+ * the free position, the order of keys is not kept.
+ */
+class GpgKeyStore
+{
+public:
+    GpgKeyStore();
+
+    void clear();
+    void reserve(int size);
+
+    /**
+     * @details Add key to the store, a key with the same fingerprint is replaced.
+     */
+    void insert(const GpgKey &key);
+    /**
+     * @details Remove the key with primary fingerprint fpr.
+     *
+     * @return false, if there is no such key in the store
+     */
+    bool remove(const QString &fpr);
+
+    /**
+     * @details Set the privkey flag of the key with fingerprint fpr.
+     *
+     * @return false, if there is no such key in the store
+     */
+    bool markPrivate(const QString &fpr);
+
+    int size() const;
+    const GpgKey &at(int i) const;
+    /**
+     * @return Position of the key with primary fingerprint fpr, -1 if not found
+     */
+    int indexOf(const QString &fpr) const;
+    /**
+     * @details All keys in keyring order, implicitly shared with the store.
+     */
+    GpgKeyList keys() const;
+
+    /**
+     * @return The key with (sub)key fingerprint fpr, 0 if not found
+     */
+    const GpgKey *findByFpr(const QString &fpr) const;
+    /**
+     * @details id may be a short (8) or long (16) key id of a (sub)key, for
+     * longer strings the trailing 16 characters are used, so v4 fingerprints
+     * are found too.
+     *
+     * @return The key or 0, if not found
+     */
+    const GpgKey *findById(const QString &id) const;
+    /**
+     * @return All keys with email on their primary user id, case insensitive
+     */
+    GpgKeyList findByEmail(const QString &email) const;
+
+private:
+    int primaryPosition(const QString &fpr) const;
+    void addToIndex(int pos);
+    void removeFromIndex(int pos);
+
+    GpgKeyList mKeys;
+    QHash<QString, int> mFprIndex;
+    QHash<QString, int> mLongIdIndex;
+    QHash<QString, int> mShortIdIndex;
+    QMultiHash<QString, int> mEmailIndex;
+};
+
+#endif // __GPGKEYSTORE_H__
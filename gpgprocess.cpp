@@ -0,0 +1,216 @@
+/*
+ *      gpgprocess.cpp
+ *
+ *      Copyright 2008 gpg4usb-team <gpg4usb@cpunk.de>
+ *
+ *      This file is part of gpg4usb.
+ *
+ *      Gpg4usb is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      Gpg4usb is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with gpg4usb.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "gpgprocess.h"
+#include <QDebug>
+
+namespace GpgME
+{
+
+GpgProcess::GpgProcess(const QString &gpgBin, const QString &homeDir, QObject *parent)
+        : QObject(parent)
+{
+    mGpgBin = gpgBin;
+    mHomeDir = homeDir;
+    mOutputDevice = 0;
+    mBytesWritten = 0;
+    mRunning = false;
+    mSuccess = false;
+    mCanceled = false;
+    mHadProgress = false;
+
+    connect(&mProcess, SIGNAL(readyReadStandardOutput()), this, SLOT(slotReadStdOut()));
+    connect(&mProcess, SIGNAL(readyReadStandardError()), this, SLOT(slotReadStdErr()));
+    connect(&mProcess, SIGNAL(finished(int, QProcess::ExitStatus)), this, SLOT(slotFinished(int, QProcess::ExitStatus)));
+    connect(&mProcess, SIGNAL(error(QProcess::ProcessError)), this, SLOT(slotError(QProcess::ProcessError)));
+}
+
+void GpgProcess::setOutputDevice(QIODevice *device)
+{
+    mOutputDevice = device;
+}
+
+void GpgProcess::start(const QStringList &arguments, const QByteArray &input)
+{
+    QStringList args;
+    args << "--homedir" << mHomeDir << "--batch" << "--status-fd" << "2" << arguments;
+    qDebug() << args;
+
+    mRunning = true;
+    mProcess.start(mGpgBin, args);
+    if (!input.isEmpty()) {
+        mProcess.write(input);
+    }
+    mProcess.closeWriteChannel();
+}
+
+bool GpgProcess::waitForFinished(int msecs)
+{
+    // finished() is emitted from within, but not if gpg couldn't be started
+    if (msecs < 0) {
+        while (mRunning && mProcess.state() != QProcess::NotRunning) {
+            mProcess.waitForFinished(-1);
+        }
+    } else if (mRunning && mProcess.state() != QProcess::NotRunning) {
+        mProcess.waitForFinished(msecs);
+    }
+    if (mRunning && mProcess.state() == QProcess::NotRunning) {
+        // without an event loop error() isn't delivered
+        slotError(QProcess::FailedToStart);
+    }
+    return mSuccess;
+}
+
+bool GpgProcess::isRunning() const
+{
+    return mRunning;
+}
+
+bool GpgProcess::success() const
+{
+    return mSuccess;
+}
+
+bool GpgProcess::isCanceled() const
+{
+    return mCanceled;
+}
+
+QByteArray GpgProcess::readAllOutput()
+{
+    QByteArray output = mOutput;
+    mOutput.clear();
+    return output;
+}
+
+qint64 GpgProcess::bytesWritten() const
+{
+    return mBytesWritten;
+}
+
+QByteArray GpgProcess::log() const
+{
+    return mLog;
+}
+
+QList<QByteArray> GpgProcess::statusLines() const
+{
+    return mStatusLines;
+}
+
+QString GpgProcess::errorString() const
+{
+    if (!mErrorString.isEmpty()) {
+        return mErrorString;
+    }
+    return QString::fromLocal8Bit(mLog).trimmed();
+}
+
+void GpgProcess::cancel()
+{
+    if (mRunning) {
+        mCanceled = true;
+        mProcess.kill();
+    }
+}
+
+void GpgProcess::slotReadStdOut()
+{
+    QByteArray data = mProcess.readAllStandardOutput();
+    mBytesWritten += data.size();
+    if (mOutputDevice) {
+        mOutputDevice->write(data);
+    } else {
+        mOutput.append(data);
+    }
+    if (!mHadProgress) {
+        emit signalProgress(mBytesWritten, 0);
+    }
+}
+
+void GpgProcess::slotReadStdErr()
+{
+    mStdErr.append(mProcess.readAllStandardError());
+    int end;
+    while ((end = mStdErr.indexOf('\n')) >= 0) {
+        parseStdErrLine(mStdErr.left(end));
+        mStdErr.remove(0, end + 1);
+    }
+}
+
+/** "[GNUPG:] KEYWORD arguments" is a status line, everything else log
+ */
+void GpgProcess::parseStdErrLine(const QByteArray &line)
+{
+    const QByteArray prefix = "[GNUPG:] ";
+    if (!line.startsWith(prefix)) {
+        mLog.append(line).append('\n');
+        return;
+    }
+
+    QByteArray status = line.mid(prefix.size()).trimmed();
+    mStatusLines.append(status);
+    int space = status.indexOf(' ');
+    QByteArray keyword = space < 0 ? status : status.left(space);
+    QByteArray arguments = space < 0 ? QByteArray() : status.mid(space + 1);
+    emit signalStatus(keyword, arguments);
+
+    // PROGRESS <what> <char> <cur> <total>
+    if (keyword == "PROGRESS") {
+        QList<QByteArray> fields = arguments.split(' ');
+        if (fields.size() >= 4) {
+            mHadProgress = true;
+            emit signalProgress(fields.at(2).toLongLong(), fields.at(3).toLongLong());
+        }
+    }
+}
+
+void GpgProcess::slotFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    // the pipes may still hold data when finished is emitted
+    slotReadStdOut();
+    slotReadStdErr();
+    if (!mStdErr.isEmpty()) {
+        parseStdErrLine(mStdErr);
+        mStdErr.clear();
+    }
+    finish(exitStatus == QProcess::NormalExit && exitCode == 0 && !mCanceled);
+}
+
+void GpgProcess::slotError(QProcess::ProcessError error)
+{
+    if (error == QProcess::FailedToStart) {
+        mErrorString = tr("Couldn't start %1: %2").arg(mGpgBin).arg(mProcess.errorString());
+        finish(false);
+    }
+}
+
+void GpgProcess::finish(bool success)
+{
+    if (!mRunning) {
+        return;
+    }
+    mRunning = false;
+    mSuccess = success;
+    emit signalFinished(success);
+}
+
+} // namespace GpgME
@@ -0,0 +1,141 @@
+/*
+ *      gpgprocess.h
+ *
+ *      Copyright 2008 gpg4usb-team <gpg4usb@cpunk.de>
+ *
+ *      This file is part of gpg4usb.
+ *
+ *      Gpg4usb is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      Gpg4usb is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with gpg4usb.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef __GPGPROCESS_H__
+#define __GPGPROCESS_H__
+
+#include <QProcess>
+#include <QStringList>
+
+namespace GpgME
+{
+
+/**
+ * @brief Runs the gpg binary directly, for what gpgme doesn't offer
+ *
+ * @details stdout is streamed into an output device or collected in a buffer
+ * while gpg runs, so output of any size is read completely. The status lines
+ * of --status-fd are parsed from stderr and emitted as signalStatus, the
+ * remaining stderr lines are kept as log. Use the signals for asynchronous
+ * operation, or waitForFinished() to block without an event loop.
+ */
+class GpgProcess : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @param gpgBin The gpg binary
+     * @param homeDir The gpg home directory, passed with --homedir
+     */
+    GpgProcess(const QString &gpgBin, const QString &homeDir, QObject *parent = 0);
+
+    /**
+     * @details Write stdout of gpg to device instead of the output buffer,
+     * set before start().
+     */
+    void setOutputDevice(QIODevice *device);
+    /**
+     * @details Start gpg in batch mode with arguments, input is written to
+     * its stdin.
+     */
+    void start(const QStringList &arguments, const QByteArray &input = QByteArray());
+    /**
+     * @details Block until gpg is finished, signals are still emitted. With
+     * msecs >= 0 return after msecs at the latest, isRunning() tells whether
+     * gpg is done.
+     *
+     * @return success()
+     */
+    bool waitForFinished(int msecs = -1);
+
+    bool isRunning() const;
+    /**
+     * @details gpg finished with exit code 0 and wasn't canceled.
+     */
+    bool success() const;
+    bool isCanceled() const;
+
+    /**
+     * @details Take the buffered stdout, if no output device is set.
+     */
+    QByteArray readAllOutput();
+    /**
+     * @details Number of bytes gpg wrote to stdout so far.
+     */
+    qint64 bytesWritten() const;
+    /**
+     * @details stderr of gpg without the status lines.
+     */
+    QByteArray log() const;
+    QList<QByteArray> statusLines() const;
+    /**
+     * @details The log, or why gpg couldn't run at all.
+     */
+    QString errorString() const;
+
+public slots:
+    /**
+     * @details Kill gpg, signalFinished reports failure.
+     */
+    void cancel();
+
+signals:
+    /**
+     * @details A --status-fd line, e.g. keyword "IMPORT_OK" and its arguments.
+     */
+    void signalStatus(const QByteArray &keyword, const QByteArray &arguments);
+    /**
+     * @details From the PROGRESS status of gpg, total is 0 if unknown.
+     * Without PROGRESS lines, current are the bytes written to stdout.
+     */
+    void signalProgress(qint64 current, qint64 total);
+    void signalFinished(bool success);
+
+private slots:
+    void slotReadStdOut();
+    void slotReadStdErr();
+    void slotFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void slotError(QProcess::ProcessError error);
+
+private:
+    void parseStdErrLine(const QByteArray &line);
+    void finish(bool success);
+
+    QProcess mProcess;
+    QString mGpgBin;
+    QString mHomeDir;
+    QIODevice *mOutputDevice;
+    QByteArray mOutput;
+    qint64 mBytesWritten;
+    QByteArray mStdErr; /** incomplete last line of stderr */
+    QByteArray mLog;
+    QList<QByteArray> mStatusLines;
+    QString mErrorString;
+    bool mRunning;
+    bool mSuccess;
+    bool mCanceled;
+    bool mHadProgress; /** gpg reports PROGRESS, don't report bytes */
+};
+
+} // namespace GpgME
+
+#endif // __GPGPROCESS_H__
@@ -193,7 +193,10 @@ void KeyDetailsDialog::slotExportPrivateKey()
     // export key, if ok was clicked
     if (ret == QMessageBox::Ok) {
         QByteArray *keyArray = new QByteArray();
-        mCtx->exportSecretKey(*keyid, keyArray);
+        if (!mCtx->exportSecretKey(*keyid, keyArray)) {
+            delete keyArray;
+            return;
+        }
         gpgme_key_t key = mCtx->getKeyDetails(*keyid);
         QString fileString = QString::fromUtf8(key->uids->name) + " " + QString::fromUtf8(key->uids->email) + "(" + QString(key->subkeys->keyid)+ ")_pub_sec.asc";
         QString fileName = QFileDialog::getSaveFileName(this, tr("Export Key To File"), fileString, tr("Key Files") + " (*.asc *.txt);;All Files (*)");
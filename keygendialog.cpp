@@ -26,6 +26,7 @@ KeyGenDialog::KeyGenDialog(GpgME::GpgContext *ctx, QWidget *parent)
  : QDialog(parent)
 {
     mCtx = ctx;
+    mStepLabel = 0;
     buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
 
     this->setWindowTitle(tr("Generate Key"));
@@ -166,8 +167,7 @@ void KeyGenDialog::slotKeyGenAccept()
         }
         keyGenParams += "</GnupgKeyParms>";
 
-        KeyGenThread *kg = new KeyGenThread(keyGenParams, mCtx);
-        kg->start();
+        GpgME::GpgProcess *gpg = mCtx->generateKeyAsync(keyGenParams);
 
         this->accept();
 
@@ -178,20 +178,39 @@ void KeyGenDialog::slotKeyGenAccept()
         QLabel *waitMessage = new QLabel(tr("Collecting random data for key generation.\n This may take a while.\n To speed up the process use your computer\n (e.g. browse the net, listen to music,...)"));
         QProgressBar *pb = new QProgressBar();
         pb->setRange(0, 0);
+        // gpg reports a step of the prime generation, show them as running count
+        QLabel *stepLabel = new QLabel();
+        connect(gpg, SIGNAL(signalProgress(qint64, qint64)), this, SLOT(slotKeyGenProgress()));
+        mStepLabel = stepLabel;
+        mSteps = 0;
+        QDialogButtonBox *cancelBox = new QDialogButtonBox(QDialogButtonBox::Cancel);
+        connect(cancelBox, SIGNAL(rejected()), dialog, SLOT(reject()));
+        connect(dialog, SIGNAL(rejected()), gpg, SLOT(cancel()));
 
         QVBoxLayout *layout = new QVBoxLayout(dialog);
         layout->addWidget(waitMessage);
         layout->addWidget(pb);
+        layout->addWidget(stepLabel);
+        layout->addWidget(cancelBox);
         dialog->setLayout(layout);
 
         dialog->show();
 
-        while (kg->isRunning()) {
-            QCoreApplication::processEvents();
+        // wait without blocking the gui, gpg runs in its own process
+        QEventLoop loop;
+        connect(gpg, SIGNAL(signalFinished(bool)), &loop, SLOT(quit()));
+        if (gpg->isRunning()) {
+            loop.exec();
         }
 
         dialog->close();
-        QMessageBox::information(0,tr("Success"),tr("New key created"));
+        mStepLabel = 0;
+        if (gpg->success()) {
+            QMessageBox::information(0,tr("Success"),tr("New key created"));
+        } else if (!gpg->isCanceled()) {
+            QMessageBox::critical(0, tr("Error"), tr("Key generation failed:\n%1").arg(gpg->errorString()));
+        }
+        gpg->deleteLater();
     } else {
         /**
          * create error message
@@ -206,6 +225,14 @@ void KeyGenDialog::slotKeyGenAccept()
     }
 }
 
+void KeyGenDialog::slotKeyGenProgress()
+{
+    if (mStepLabel) {
+        mSteps++;
+        mStepLabel->setText(tr("%1 steps of prime generation done").arg(mSteps));
+    }
+}
+
 void KeyGenDialog::slotExpireBoxChanged()
 {
     if (expireCheckBox->checkState()) {
@@ -22,8 +22,8 @@
 #ifndef __KEYGENDIALOG_H__
 #define __KEYGENDIALOG_H__
 
-#include "keygenthread.h"
 #include "gpgcontext.h"
+#include "gpgprocess.h"
 #include <QtGui>
 
 QT_BEGIN_NAMESPACE
@@ -51,7 +51,8 @@ private:
     int checkPassWordStrength();
 
     GpgME::GpgContext *mCtx; /** The current gpg context */
-    KeyGenThread *keyGenThread; /** Thread for key generation */
+    QLabel *mStepLabel; /** Label counting the progress of the running key generation */
+    int mSteps; /** Progress reports of the running key generation */
     QStringList errorMessages; /** List of errors occuring when checking entries of lineedits */
     QDialogButtonBox *buttonBox; /** Box for standardbuttons */
     QLabel *errorLabel; /** Label containing error message */
@@ -67,6 +68,11 @@ private:
     QSlider *pwStrengthSlider; /** Slider showing the password strength */
 
 private slots:
+    /**
+     * @details gpg reported progress of the key generation
+     */
+    void slotKeyGenProgress();
+
     /**
      * @details when expirebox was checked/unchecked, enable/disable the expiration date box
      */
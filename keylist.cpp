@@ -26,12 +26,20 @@ KeyList::KeyList(GpgME::GpgContext *ctx, QWidget *parent)
 {
     mCtx = ctx;
 
-    mKeyList = new QTableWidget(this);
-    mKeyList->setColumnCount(6);
+    mModel = new KeyListModel(this);
+    mProxyModel = new KeyListProxyModel(this);
+    mProxyModel->setSourceModel(mModel);
+    mProxyModel->setSortRole(KeyListModel::SortRole);
+    mProxyModel->setSortCaseSensitivity(Qt::CaseInsensitive);
+    mProxyModel->setDynamicSortFilter(true);
+
+    mKeyList = new QTableView(this);
+    mKeyList->setModel(mProxyModel);
     mKeyList->verticalHeader()->hide();
     mKeyList->setShowGrid(false);
     mKeyList->setColumnWidth(0, 24);
     mKeyList->setColumnWidth(1, 20);
+    mKeyList->setSortingEnabled(true);
     mKeyList->sortByColumn(2, Qt::AscendingOrder);
     mKeyList->setSelectionBehavior(QAbstractItemView::SelectRows);
     // hide id and fingerprint of key
@@ -46,137 +54,94 @@ KeyList::KeyList(GpgME::GpgContext *ctx, QWidget *parent)
 
     mKeyList->setAlternatingRowColors(true);
 
-    QStringList labels;
-    labels << "" << "" << tr("Name") << tr("EMail") << "id" << "fpr";
-    mKeyList->setHorizontalHeaderLabels(labels);
     mKeyList->horizontalHeader()->setStretchLastSection(true);
 
+    // search as you type in name, email, key id and fingerprint
+    mSearchEdit = new QLineEdit(this);
+    mSearchEdit->setToolTip(tr("Show only keys with words starting like the search words"));
+    connect(mSearchEdit, SIGNAL(textChanged(QString)), this, SLOT(slotSearch()));
+    QLabel *searchLabel = new QLabel(tr("Search:"), this);
+    searchLabel->setBuddy(mSearchEdit);
+    QHBoxLayout *searchLayout = new QHBoxLayout;
+    searchLayout->addWidget(searchLabel);
+    searchLayout->addWidget(mSearchEdit);
+
     QVBoxLayout *layout = new QVBoxLayout;
+    layout->addLayout(searchLayout);
     layout->addWidget(mKeyList);
     layout->setContentsMargins(0, 0, 0, 0);
     layout->setSpacing(3);
     setLayout(layout);
 
     popupMenu = new QMenu(this);
-    connect(mCtx, SIGNAL(signalKeyDBChanged()), this, SLOT(slotRefresh()));
+    // the context lists the keyring once per change, all keylists share the result
+    connect(mCtx, SIGNAL(signalKeyListRefreshed()), this, SLOT(slotRefresh()));
+    connect(mCtx, SIGNAL(signalKeysUpdated(QStringList)), this, SLOT(slotUpdateKeys(QStringList)));
     setAcceptDrops(true);
     slotRefresh();
 }
 
 void KeyList::slotRefresh()
 {
-    QStringList *keyList;
-    keyList = getChecked();
-    // while filling the table, sort enabled causes errors
-    mKeyList->setSortingEnabled(false);
-    mKeyList->clearContents();
-
-    GpgKeyList keys = mCtx->listKeys();
-    mKeyList->setRowCount(keys.size());
-
-    int row = 0;
-    GpgKeyList::iterator it = keys.begin();
-    while (it != keys.end()) {
-
-        QTableWidgetItem *tmp0 = new QTableWidgetItem();
-        tmp0->setFlags(Qt::ItemIsUserCheckable | Qt::ItemIsEnabled | Qt::ItemIsSelectable);
-        tmp0->setCheckState(Qt::Unchecked);
-        mKeyList->setItem(row, 0, tmp0);
-
-        if (it->privkey) {
-            QTableWidgetItem *tmp1 = new QTableWidgetItem(QIcon(":kgpg_key2.png"), "");
-            mKeyList->setItem(row, 1, tmp1);
-        }
-        QTableWidgetItem *tmp2 = new QTableWidgetItem(it->name);
-        tmp2->setToolTip(it->name);
-        mKeyList->setItem(row, 2, tmp2);
-        QTableWidgetItem *tmp3 = new QTableWidgetItem(it->email);
-        tmp3->setToolTip(it->email);
-        // strike out expired keys
-        if(it->expired || it->revoked) {
-            QFont strike = tmp2->font();
-            strike.setStrikeOut(true);
-            tmp2->setFont(strike);
-            tmp3->setFont(strike);
-        }
-        mKeyList->setItem(row, 3, tmp3);
-        QTableWidgetItem *tmp4 = new QTableWidgetItem(it->id);
-        mKeyList->setItem(row, 4, tmp4);
-        QTableWidgetItem *tmp5 = new QTableWidgetItem(it->fpr);
-        mKeyList->setItem(row, 5, tmp5);
+    mModel->setSnapshot(mCtx->keySnapshot());
+    slotSearch();
+}
 
+/** Patch the rows of the keys with fingerprints fprs, the
+ *  other rows and the check states are kept
+ */
+void KeyList::slotUpdateKeys(QStringList fprs)
+{
+    mModel->updateKeys(mCtx->keySnapshot(), fprs);
+    slotSearch();
+}
 
-        it++;
-        ++row;
+/** Filter the keys with the search index of the
+ *  current snapshot
+ */
+void KeyList::slotSearch()
+{
+    QString text = mSearchEdit->text().trimmed();
+    if (text.isEmpty()) {
+        mProxyModel->setMatches(QBitArray());
+    } else {
+        mProxyModel->setMatches(mCtx->keySearchIndex()->search(text));
     }
-    mKeyList->setSortingEnabled(true);
-    setChecked(keyList);
 }
 
 QStringList *KeyList::getChecked()
 {
-    QStringList *ret = new QStringList();
-    for (int i = 0; i < mKeyList->rowCount(); i++) {
-        if (mKeyList->item(i, 0)->checkState() == Qt::Checked) {
-            *ret << mKeyList->item(i, 4)->text();
-        }
-    }
-    return ret;
+    return new QStringList(mModel->checkedIds());
 }
 
 QStringList *KeyList::getAllPrivateKeys()
 {
-    QStringList *ret = new QStringList();
-    for (int i = 0; i < mKeyList->rowCount(); i++) {
-        if (mKeyList->item(i, 1)) {
-            *ret << mKeyList->item(i, 4)->text();
-        }
-    }
-    return ret;
+    return new QStringList(mModel->privateIds());
 }
 
 QStringList *KeyList::getPrivateChecked()
 {
-    QStringList *ret = new QStringList();
-    for (int i = 0; i < mKeyList->rowCount(); i++) {
-        if ((mKeyList->item(i, 0)->checkState() == Qt::Checked) && (mKeyList->item(i, 1))) {
-            *ret << mKeyList->item(i, 4)->text();
-        }
-    }
-    return ret;
+    return new QStringList(mModel->privateCheckedIds());
 }
 
 void KeyList::setChecked(QStringList *keyIds)
 {
-    if (!keyIds->isEmpty()) {
-        for (int i = 0; i < mKeyList->rowCount(); i++) {
-            if (keyIds->contains(mKeyList->item(i, 4)->text()))  {
-                mKeyList->item(i, 0)->setCheckState(Qt::Checked);
-            }
-        }
-    }
+    mModel->setChecked(*keyIds);
 }
 
 QStringList *KeyList::getSelected()
 {
     QStringList *ret = new QStringList();
 
-    for (int i = 0; i < mKeyList->rowCount(); i++) {
-        if (mKeyList->item(i, 0)->isSelected() == 1) {
-            *ret << mKeyList->item(i, 4)->text();
-        }
+    foreach (QModelIndex index, mKeyList->selectionModel()->selectedRows()) {
+        *ret << mModel->keyAt(mProxyModel->mapToSource(index).row()).id;
     }
     return ret;
 }
 
 bool KeyList::containsPrivateKeys()
 {
-    for (int i = 0; i < mKeyList->rowCount(); i++) {
-        if (mKeyList->item(i, 1)) {
-            return  true;
-        }
-    }
-    return false;
+    return !mModel->privateIds().isEmpty();
 }
 
 void KeyList::setColumnWidth(int row, int size)
@@ -271,6 +236,17 @@ void KeyList::markKeys(QStringList *keyIds)
 
 void KeyList::importKeys(QByteArray inBuffer)
 {
-    GpgImportInformation result = mCtx->importKey(inBuffer);
-    new KeyImportDetailDialog(mCtx, result, this);
+    // gpg imports in the job pool, the result is shown when it's done
+    GpgME::GpgJob *job = mCtx->importKeyAsync(inBuffer);
+    connect(job, SIGNAL(signalFinished(GpgME::GpgJob*)), this, SLOT(slotImportFinished(GpgME::GpgJob*)));
+}
+
+void KeyList::slotImportFinished(GpgME::GpgJob *job)
+{
+    if (job->success()) {
+        new KeyImportDetailDialog(mCtx, job->importInformation(), this);
+    } else {
+        QMessageBox::critical(this, tr("Import error"), job->errorString());
+    }
+    job->deleteLater();
 }
@@ -23,13 +23,16 @@
 #define __KEYLIST_H__
 
 #include "gpgcontext.h"
+#include "gpgjob.h"
 #include "keyimportdetaildialog.h"
+#include "keylistmodel.h"
 
 QT_BEGIN_NAMESPACE
 class QWidget;
 class QVBoxLayout;
 class QLabel;
-class QTableWidget;
+class QTableView;
+class QLineEdit;
 class QMenu;
 QT_END_NAMESPACE
 
@@ -54,11 +57,19 @@ public:
 
 public slots:
     void slotRefresh();
+    void slotUpdateKeys(QStringList fprs);
+
+private slots:
+    void slotSearch();
+    void slotImportFinished(GpgME::GpgJob *job);
 
 private:
     void importKeys(QByteArray inBuffer);
     GpgME::GpgContext *mCtx;
-    QTableWidget *mKeyList;
+    QTableView *mKeyList;
+    KeyListModel *mModel;
+    KeyListProxyModel *mProxyModel;
+    QLineEdit *mSearchEdit;
     QMenu *popupMenu;
 
 protected:
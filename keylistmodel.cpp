@@ -0,0 +1,343 @@
+/*
+ *      keylistmodel.cpp
+ *
+ *      Copyright 2008 gpg4usb-team <gpg4usb@cpunk.de>
+ *
+ *      This file is part of gpg4usb.
+ *
+ *      Gpg4usb is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      Gpg4usb is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with gpg4usb.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "keylistmodel.h"
+
+KeyListModel::KeyListModel(QObject *parent) :
+        QAbstractTableModel(parent)
+{
+    mSnapshot = QSharedPointer<const GpgKeyStore>(new GpgKeyStore());
+    mReordering = false;
+    mPrivateIcon = QIcon(":kgpg_key2.png");
+    mStrikeFont.setStrikeOut(true);
+}
+
+int KeyListModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return mReordering ? mOrder.size() : mSnapshot->size();
+}
+
+int KeyListModel::columnCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return ColumnCount;
+}
+
+QVariant KeyListModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= rowCount())
+        return QVariant();
+
+    const GpgKey &key = mSnapshot->at(storeIndex(index.row()));
+
+    switch (role) {
+    case Qt::DisplayRole:
+    case Qt::ToolTipRole:
+        switch (index.column()) {
+        case NameColumn:
+            return key.name;
+        case EmailColumn:
+            return key.email;
+        case IdColumn:
+            return key.id;
+        case FprColumn:
+            return key.fpr;
+        }
+        break;
+
+    case Qt::CheckStateRole:
+        if (index.column() == CheckColumn)
+            return mCheckedIds.contains(key.id) ? Qt::Checked : Qt::Unchecked;
+        break;
+
+    case Qt::DecorationRole:
+        if (index.column() == PrivateColumn && key.privkey)
+            return mPrivateIcon;
+        break;
+
+    // strike out expired keys
+    case Qt::FontRole:
+        if ((index.column() == NameColumn || index.column() == EmailColumn)
+                && (key.expired || key.revoked))
+            return mStrikeFont;
+        break;
+
+    case SortRole:
+        switch (index.column()) {
+        case CheckColumn:
+            return mCheckedIds.contains(key.id);
+        case PrivateColumn:
+            return key.privkey;
+        case NameColumn:
+            return key.name;
+        case EmailColumn:
+            return key.email;
+        case IdColumn:
+            return key.id;
+        case FprColumn:
+            return key.fpr;
+        }
+        break;
+    }
+    return QVariant();
+}
+
+QVariant KeyListModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role != Qt::DisplayRole || orientation != Qt::Horizontal)
+        return QVariant();
+
+    switch (section) {
+    case NameColumn:
+        return tr("Name");
+    case EmailColumn:
+        return tr("EMail");
+    case IdColumn:
+        return "id";
+    case FprColumn:
+        return "fpr";
+    default:
+        return QString();
+    }
+}
+
+Qt::ItemFlags KeyListModel::flags(const QModelIndex &index) const
+{
+    if (!index.isValid())
+        return 0;
+    if (index.column() == CheckColumn)
+        return Qt::ItemIsUserCheckable | Qt::ItemIsEnabled | Qt::ItemIsSelectable;
+    return Qt::ItemIsEnabled | Qt::ItemIsSelectable;
+}
+
+bool KeyListModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    if (!index.isValid() || index.column() != CheckColumn || role != Qt::CheckStateRole)
+        return false;
+
+    const QString &id = mSnapshot->at(storeIndex(index.row())).id;
+    if (value.toInt() == Qt::Checked) {
+        mCheckedIds.insert(id);
+    } else {
+        mCheckedIds.remove(id);
+    }
+    emit dataChanged(index, index);
+    return true;
+}
+
+void KeyListModel::setSnapshot(QSharedPointer<const GpgKeyStore> snapshot)
+{
+    beginResetModel();
+    mSnapshot = snapshot;
+
+    QSet<QString> checked;
+    foreach (QString id, mCheckedIds) {
+        if (mSnapshot->findById(id))
+            checked.insert(id);
+    }
+    mCheckedIds = checked;
+    updatePrivateIds();
+    endResetModel();
+}
+
+void KeyListModel::updateKeys(QSharedPointer<const GpgKeyStore> snapshot, const QStringList &fprs)
+{
+    QSharedPointer<const GpgKeyStore> old = mSnapshot;
+
+    foreach (QString fpr, fprs) {
+        if (snapshot->indexOf(fpr) < 0) {
+            const GpgKey *key = old->findByFpr(fpr);
+            if (key) {
+                mCheckedIds.remove(key->id);
+                mPrivateIds.remove(key->id);
+            }
+        } else {
+            const GpgKey &key = snapshot->at(snapshot->indexOf(fpr));
+            if (key.privkey)
+                mPrivateIds.insert(key.id);
+            else
+                mPrivateIds.remove(key.id);
+        }
+    }
+
+    // old row of every key in the new snapshot, -1 for new keys. Removing
+    // moves keys of the end into the free rows, the others keep their row
+    QVector<int> oldRows(snapshot->size(), -1);
+    QVector<int> removedRows;
+    for (int i = 0; i < old->size(); i++) {
+        const QString &fpr = old->at(i).fpr;
+        int row = (i < snapshot->size() && snapshot->at(i).fpr == fpr) ? i : snapshot->indexOf(fpr);
+        if (row >= 0)
+            oldRows[row] = i;
+        else
+            removedRows << i;
+    }
+
+    // the kept keys in their new order, the removed ones behind them
+    mReordering = true;
+    mOrder.clear();
+    foreach (int row, oldRows) {
+        if (row >= 0)
+            mOrder << row;
+    }
+    int kept = mOrder.size();
+    QVector<int> order = mOrder + removedRows;
+    mOrder.clear();
+    for (int i = 0; i < old->size(); i++)
+        mOrder << i;
+    moveRows(order);
+
+    if (!removedRows.isEmpty()) {
+        beginRemoveRows(QModelIndex(), kept, old->size() - 1);
+        mOrder.resize(kept);
+        endRemoveRows();
+    }
+
+    // same keys in the same rows, read from the new snapshot
+    mSnapshot = snapshot;
+    mOrder.clear();
+    QVector<int> added;
+    for (int i = 0; i < oldRows.size(); i++) {
+        if (oldRows.at(i) >= 0)
+            mOrder << i;
+        else
+            added << i;
+    }
+    if (!added.isEmpty()) {
+        beginInsertRows(QModelIndex(), kept, kept + added.size() - 1);
+        mOrder += added;
+        endInsertRows();
+    }
+
+    // rows in store order again
+    QVector<int> storeOrder;
+    for (int i = 0; i < mSnapshot->size(); i++)
+        storeOrder << i;
+    moveRows(storeOrder);
+    mReordering = false;
+    mOrder.clear();
+
+    foreach (QString fpr, fprs) {
+        int row = snapshot->indexOf(fpr);
+        if (row >= 0)
+            emit dataChanged(index(row, 0), index(row, ColumnCount - 1));
+    }
+}
+
+/** Show the rows in order, given as indexes into mSnapshot. The
+ *  row count doesn't change, persistent indexes (selection, proxy
+ *  mapping) move with their keys
+ */
+void KeyListModel::moveRows(const QVector<int> &order)
+{
+    if (order == mOrder)
+        return;
+
+    emit layoutAboutToBeChanged();
+    QVector<int> rows(mSnapshot->size(), -1);
+    for (int i = 0; i < order.size(); i++)
+        rows[order.at(i)] = i;
+    QModelIndexList from = persistentIndexList();
+    QModelIndexList to;
+    foreach (QModelIndex index, from) {
+        int row = rows.at(mOrder.at(index.row()));
+        to << ((row < 0) ? QModelIndex() : createIndex(row, index.column()));
+    }
+    mOrder = order;
+    changePersistentIndexList(from, to);
+    emit layoutChanged();
+}
+
+int KeyListModel::storeIndex(int row) const
+{
+    return mReordering ? mOrder.at(row) : row;
+}
+
+const GpgKey &KeyListModel::keyAt(int row) const
+{
+    return mSnapshot->at(storeIndex(row));
+}
+
+QStringList KeyListModel::checkedIds() const
+{
+    QStringList ids = mCheckedIds.toList();
+    ids.sort();
+    return ids;
+}
+
+QStringList KeyListModel::privateCheckedIds() const
+{
+    QStringList ids = (mCheckedIds & mPrivateIds).toList();
+    ids.sort();
+    return ids;
+}
+
+QStringList KeyListModel::privateIds() const
+{
+    QStringList ids = mPrivateIds.toList();
+    ids.sort();
+    return ids;
+}
+
+void KeyListModel::setChecked(const QStringList &ids)
+{
+    foreach (QString id, ids) {
+        const GpgKey *key = mSnapshot->findById(id);
+        if (key && !mCheckedIds.contains(key->id)) {
+            mCheckedIds.insert(key->id);
+            int row = mSnapshot->indexOf(key->fpr);
+            emit dataChanged(index(row, CheckColumn), index(row, CheckColumn));
+        }
+    }
+}
+
+void KeyListModel::updatePrivateIds()
+{
+    mPrivateIds.clear();
+    for (int i = 0; i < mSnapshot->size(); i++) {
+        if (mSnapshot->at(i).privkey)
+            mPrivateIds.insert(mSnapshot->at(i).id);
+    }
+}
+
+KeyListProxyModel::KeyListProxyModel(QObject *parent) :
+        QSortFilterProxyModel(parent)
+{
+}
+
+void KeyListProxyModel::setMatches(const QBitArray &matches)
+{
+    if (matches.isNull() && mMatches.isNull())
+        return;
+    mMatches = matches;
+    invalidateFilter();
+}
+
+bool KeyListProxyModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
+{
+    Q_UNUSED(sourceParent);
+    if (mMatches.isNull() || sourceRow >= mMatches.size())
+        return true;
+    return mMatches.testBit(sourceRow);
+}
@@ -0,0 +1,125 @@
+/*
+ *      keylistmodel.h
+ *
+ *      Copyright 2008 gpg4usb-team <gpg4usb@cpunk.de>
+ *
+ *      This file is part of gpg4usb.
+ *
+ *      Gpg4usb is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      Gpg4usb is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with gpg4usb.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef __KEYLISTMODEL_H__
+#define __KEYLISTMODEL_H__
+
+#include "gpgkeystore.h"
+#include <QAbstractTableModel>
+#include <QBitArray>
+#include <QFont>
+#include <QIcon>
+#include <QSet>
+#include <QSharedPointer>
+#include <QSortFilterProxyModel>
+#include <QVector>
+
+/**
+ * @brief Table model over a key snapshot of GpgContext
+ *
+ * @details Rows are the keys of the snapshot in store order, nothing is copied
+ * per key, so views only touch the rows they show. Columns are: checkbox,
+ * private key icon, name, email, key id and fingerprint. The checked keys are
+ * kept as a set of key ids, which survives refreshes of the snapshot.
+ */
+class KeyListModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column {
+        CheckColumn = 0,
+        PrivateColumn,
+        NameColumn,
+        EmailColumn,
+        IdColumn,
+        FprColumn,
+        ColumnCount
+    };
+
+    /** role returning a sortable value for every column */
+    static const int SortRole = Qt::UserRole;
+
+    KeyListModel(QObject *parent = 0);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role) const;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const;
+    Qt::ItemFlags flags(const QModelIndex &index) const;
+    bool setData(const QModelIndex &index, const QVariant &value, int role);
+
+    /**
+     * @details Show all keys of snapshot, checked keys missing in it are unchecked.
+     */
+    void setSnapshot(QSharedPointer<const GpgKeyStore> snapshot);
+    /**
+     * @details Show snapshot, which differs from the current one only in the
+     * keys with the fingerprints fprs. Unchanged rows are kept, removed and
+     * new keys are announced with rowsRemoved and rowsInserted.
+     */
+    void updateKeys(QSharedPointer<const GpgKeyStore> snapshot, const QStringList &fprs);
+
+    const GpgKey &keyAt(int row) const;
+
+    QStringList checkedIds() const;
+    QStringList privateCheckedIds() const;
+    QStringList privateIds() const;
+    void setChecked(const QStringList &ids);
+
+private:
+    void updatePrivateIds();
+    int storeIndex(int row) const;
+    void moveRows(const QVector<int> &order);
+
+    QSharedPointer<const GpgKeyStore> mSnapshot;
+    bool mReordering; /** updateKeys() runs, rows are mapped by mOrder */
+    QVector<int> mOrder; /** index in mSnapshot of every row while mReordering */
+    QSet<QString> mCheckedIds;
+    QSet<QString> mPrivateIds; /** ids of all private keys in mSnapshot */
+    QIcon mPrivateIcon;
+    QFont mStrikeFont;
+};
+
+/**
+ * @brief Sorts a KeyListModel and hides the keys not found by a search
+ */
+class KeyListProxyModel : public QSortFilterProxyModel
+{
+    Q_OBJECT
+
+public:
+    KeyListProxyModel(QObject *parent = 0);
+
+    /**
+     * @details Show only the source rows whose bit is set in matches, a null
+     * QBitArray shows all rows.
+     */
+    void setMatches(const QBitArray &matches);
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const;
+
+private:
+    QBitArray mMatches;
+};
+
+#endif // __KEYLISTMODEL_H__
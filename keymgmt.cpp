@@ -157,25 +157,44 @@ void KeyMgmt::createToolBars()
 
 void KeyMgmt::slotImportKeys(QByteArray inBuffer)
 {
-    GpgImportInformation result = mCtx->importKey(inBuffer);
-    new KeyImportDetailDialog(mCtx, result, this);
+    // gpg imports in the job pool, the result is shown when it's done
+    GpgME::GpgJob *job = mCtx->importKeyAsync(inBuffer);
+    connect(job, SIGNAL(signalFinished(GpgME::GpgJob*)), this, SLOT(slotImportFinished(GpgME::GpgJob*)));
+}
 
+void KeyMgmt::slotImportFinished(GpgME::GpgJob *job)
+{
+    if (job->success()) {
+        new KeyImportDetailDialog(mCtx, job->importInformation(), this);
+    } else {
+        QMessageBox::critical(this, tr("Import error"), job->errorString());
+    }
+    job->deleteLater();
 }
 
 void KeyMgmt::slotImportKeyFromFile()
 {
     QString fileName = QFileDialog::getOpenFileName(this, tr("Open Key"), "", tr("Key Files") + " (*.asc *.txt);;"+tr("Keyring files")+" (*.gpg);;All Files (*)");
     if (! fileName.isNull()) {
-        QFile file;
-        file.setFileName(fileName);
+        importKeyFiles(QStringList(fileName));
+    }
+}
+
+bool KeyMgmt::importKeyFiles(const QStringList &fileNames)
+{
+    GpgImportInformation result;
+    foreach (QString fileName, fileNames) {
+        QFile file(fileName);
         if (!file.open(QIODevice::ReadOnly)) {
-            qDebug() << tr("Couldn't Open File: ") + fileName;
-            return;
+            QMessageBox::critical(0, tr("Import error"), tr("Couldn't open %1").arg(fileName));
+            return false;
         }
-        QByteArray inBuffer = file.readAll();
-        slotImportKeys(inBuffer);
+        // keys imported unchanged before are not passed to gpg again
+        result.add(mCtx->importKeyFile(&file, true));
         file.close();
     }
+    new KeyImportDetailDialog(mCtx, result, this);
+    return true;
 }
 
 void KeyMgmt::slotImportKeyFromKeyServer()
@@ -210,13 +229,19 @@ void KeyMgmt::deleteKeysWithWarning(QStringList *uidList)
     if (uidList->isEmpty()) {
         return;
     }
+    // the names come from the key list, don't ask gpg for every key
+    const int maxNames = 20;
     QString keynames;
-    foreach (QString uid, *uidList) {
-        keynames.append(QString::fromUtf8(mCtx->getKeyDetails(uid)->uids->name));
+    for (int i = 0; i < uidList->size() && i < maxNames; i++) {
+        GpgKey key = mCtx->getKeyById(uidList->at(i));
+        keynames.append(Qt::escape(key.name));
         keynames.append("<i> &lt;");
-        keynames.append(QString::fromUtf8(mCtx->getKeyDetails(uid)->uids->email));
+        keynames.append(Qt::escape(key.email));
         keynames.append("&gt; </i><br/>");
     }
+    if (uidList->size() > maxNames) {
+        keynames.append(tr("and %1 more keys<br/>").arg(uidList->size() - maxNames));
+    }
 
     int ret = QMessageBox::warning(this, tr("Deleting Keys"),
                                     tr("<b>Are you sure that you want to delete the following keys?.</b><br/><br/>")+keynames+
@@ -242,21 +267,27 @@ void KeyMgmt::slotShowKeyDetails()
 
 void KeyMgmt::slotExportKeyToFile()
 {
-    QByteArray *keyArray = new QByteArray();
-    if (!mCtx->exportKeys(mKeyList->getChecked(), keyArray)) {
+    QStringList *uidList = mKeyList->getChecked();
+    if (uidList->isEmpty()) {
         return;
     }
-    gpgme_key_t key = mCtx->getKeyDetails(mKeyList->getChecked()->first());
-    QString fileString = QString::fromUtf8(key->uids->name) + " " + QString::fromUtf8(key->uids->email) + "(" + QString(key->subkeys->keyid)+ ")_pub.asc";
+    GpgKey key = mCtx->getKeyById(uidList->first());
+    QString fileString = key.name + " " + key.email + "(" + key.id + ")_pub.asc";
 
     QString fileName = QFileDialog::getSaveFileName(this, tr("Export Key To File"), fileString, tr("Key Files") + " (*.asc *.txt);;All Files (*)");
+    if (fileName.isEmpty()) {
+        return;
+    }
     QFile file(fileName);
     if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
         return;
-    QTextStream stream(&file);
-    stream << *keyArray;
+    // stream the keys to the file, a whole keyring doesn't fit in memory twice
+    bool success = mCtx->exportKeysFile(uidList, &file);
     file.close();
-    delete keyArray;
+    if (!success) {
+        file.remove();
+        return;
+    }
     emit signalStatusBarChanged(QString(tr("key(s) exported")));
 }
 
@@ -23,7 +23,6 @@
 #define __KEYMGMT_H__
 
 #include "keylist.h"
-#include "keygenthread.h"
 #include "keydetailsdialog.h"
 #include "keyimportdetaildialog.h"
 #include "keyserverimportdialog.h"
@@ -45,6 +44,13 @@ class KeyMgmt : public QMainWindow
 
 public:
     KeyMgmt(GpgME::GpgContext* ctx, QWidget *parent = 0);
+    /**
+     * @details Import the keyring files one after another, streamed from disk,
+     * and show the combined result.
+     *
+     * @return false, if a file couldn't be opened
+     */
+    bool importKeyFiles(const QStringList &fileNames);
     QAction *importKeyFromClipboardAct;
     QAction *importKeyFromFileAct;
     QAction *importKeyFromKeyServerAct;
@@ -64,6 +70,9 @@ public slots:
 signals:
     void signalStatusBarChanged(QString);
 
+private slots:
+    void slotImportFinished(GpgME::GpgJob *job);
+
 private:
     void createMenus();
     void createActions();
@@ -0,0 +1,125 @@
+/*
+ *      keysearchindex.cpp
+ *
+ *      Copyright 2008 gpg4usb-team <gpg4usb@cpunk.de>
+ *
+ *      This file is part of gpg4usb.
+ *
+ *      Gpg4usb is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      Gpg4usb is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with gpg4usb.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "keysearchindex.h"
+#include <QRegExp>
+#include <QStringList>
+
+class KeySearchIndex::WordLessThan
+{
+public:
+    WordLessThan(const QString &text) : mText(text) {}
+    bool operator()(const Word &a, const Word &b) const {
+        return QStringRef::compare(QStringRef(&mText, a.offset, a.length),
+                                   QStringRef(&mText, b.offset, b.length)) < 0;
+    }
+private:
+    const QString &mText;
+};
+
+KeySearchIndex::KeySearchIndex(const GpgKeyStore &store)
+{
+    mKeyCount = store.size();
+    mWords.reserve(mKeyCount * 8);
+
+    for (int pos = 0; pos < mKeyCount; pos++) {
+        const GpgKey &key = store.at(pos);
+        addWords(key.name, pos);
+        addWords(key.email, pos);
+        addWord(key.email, pos);
+        addWord(key.id, pos);
+        addWord(key.id.right(8), pos);
+        addWord(key.fpr, pos);
+    }
+    qSort(mWords.begin(), mWords.end(), WordLessThan(mText));
+    mWords.squeeze();
+    mText.squeeze();
+}
+
+/** split text into words at everything which is neither
+ *  letter nor digit, so emails are split at @ and dots
+ */
+void KeySearchIndex::addWords(const QString &text, int pos)
+{
+    static const QRegExp separator("[^\\w]+");
+    foreach (QString word, text.split(separator, QString::SkipEmptyParts)) {
+        addWord(word, pos);
+    }
+}
+
+void KeySearchIndex::addWord(const QString &word, int pos)
+{
+    if (word.isEmpty()) {
+        return;
+    }
+    QString lower = word.toLower();
+    Word w;
+    w.offset = mText.size();
+    w.length = lower.length();
+    w.pos = pos;
+    mText.append(lower);
+    mWords.append(w);
+}
+
+QStringRef KeySearchIndex::wordAt(int i) const
+{
+    return QStringRef(&mText, mWords.at(i).offset, mWords.at(i).length);
+}
+
+bool KeySearchIndex::startsWith(int i, const QString &prefix) const
+{
+    const Word &w = mWords.at(i);
+    if (w.length < prefix.length()) {
+        return false;
+    }
+    return QStringRef::compare(QStringRef(&mText, w.offset, prefix.length()), prefix) == 0;
+}
+
+QBitArray KeySearchIndex::search(const QString &text) const
+{
+    QBitArray result(mKeyCount, true);
+
+    foreach (QString prefix, text.toLower().split(QRegExp("\\s+"), QString::SkipEmptyParts)) {
+        // first word not less than prefix, all words starting with it follow
+        int low = 0;
+        int high = mWords.size();
+        while (low < high) {
+            int middle = (low + high) / 2;
+            if (QStringRef::compare(wordAt(middle), prefix) < 0) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+
+        QBitArray matches(mKeyCount);
+        for (int i = low; i < mWords.size() && startsWith(i, prefix); i++) {
+            matches.setBit(mWords.at(i).pos);
+        }
+        result &= matches;
+    }
+    return result;
+}
+
+int KeySearchIndex::keyCount() const
+{
+    return mKeyCount;
+}
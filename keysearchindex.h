@@ -0,0 +1,71 @@
+/*
+ *      keysearchindex.h
+ *
+ *      Copyright 2008 gpg4usb-team <gpg4usb@cpunk.de>
+ *
+ *      This file is part of gpg4usb.
+ *
+ *      Gpg4usb is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      Gpg4usb is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with gpg4usb.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef __KEYSEARCHINDEX_H__
+#define __KEYSEARCHINDEX_H__
+
+#include "gpgkeystore.h"
+#include <QBitArray>
+#include <QVector>
+
+/**
+ * @brief Prefix index over the words of name, email, key id and fingerprint
+ *
+ * @details All words of all keys are kept in one sorted list, so the keys
+ * having a word starting with a prefix are found by binary search. Words are
+ * stored as offsets into one string to keep the index small.
+ * The index belongs to one key snapshot, key positions are the positions in
+ * that GpgKeyStore.
+ */
+class KeySearchIndex
+{
+public:
+    explicit KeySearchIndex(const GpgKeyStore &store);
+
+    /**
+     * @details Find the keys matching text. Every whitespace separated part of
+     * text has to be the prefix of a word of the key, case insensitive.
+     *
+     * @return Bit i is set, if the key at position i of the store matches
+     */
+    QBitArray search(const QString &text) const;
+
+    int keyCount() const;
+
+private:
+    struct Word {
+        int offset;
+        int length;
+        int pos;
+    };
+    class WordLessThan;
+
+    void addWords(const QString &text, int pos);
+    void addWord(const QString &word, int pos);
+    QStringRef wordAt(int i) const;
+    bool startsWith(int i, const QString &prefix) const;
+
+    QString mText;
+    QVector<Word> mWords;
+    int mKeyCount;
+};
+
+#endif // __KEYSEARCHINDEX_H__
@@ -22,13 +22,18 @@
 #include <QApplication>
 #include "mainwindow.h"
 #include "gpgconstants.h"
+#include "startuptimer.h"
+#include "singleinstance.h"
 
 int main(int argc, char *argv[])
 {
+    // phases are logged with -d
+    StartupTimer::start();
 
     Q_INIT_RESOURCE(gpg4usb);
 
     QApplication app(argc, argv);
+    StartupTimer::phase("application created");
 
     // get application path
     QString appPath = qApp->applicationDirPath();
@@ -36,6 +41,15 @@ int main(int argc, char *argv[])
     app.setApplicationVersion("0.3.3");
     app.setApplicationName("gpg4usb");
 
+    // a running gpg4usb takes over the command line, before anything
+    // expensive is done here
+    SingleInstance instance;
+    if (instance.forward(app.arguments(), QDir::currentPath())) {
+        return 0;
+    }
+    instance.listen();
+    StartupTimer::phase("single instance checked");
+
     // dont show icons in menus
     app.setAttribute(Qt::AA_DontShowIconsInMenus);
 
@@ -83,6 +97,7 @@ int main(int argc, char *argv[])
     QString styleSheet = QLatin1String(file.readAll());
     qApp->setStyleSheet(styleSheet);
     file.close();
+    StartupTimer::phase("stylesheet loaded");
 
     /**
      * internationalisation. loop to restart mainwindow
@@ -90,8 +105,16 @@ int main(int argc, char *argv[])
      */
     QSettings::setDefaultFormat(QSettings::IniFormat);
     QSettings settings;
+
+    // gpgme, the key snapshot and the caches outlive the windows of the
+    // restart loop. The keyring is listed in the job pool, so the editor
+    // shows up first
+    GpgME::GpgContext ctx(QString(), true);
+    StartupTimer::phase("gpgme set up");
+
     QTranslator translator, translator2;
     int return_from_event_loop_code;
+    bool firstWindow = true;
 
 #ifdef _WIN32
     QString qtTransPrefix = "ts/qt_windows_";
@@ -114,10 +137,21 @@ int main(int argc, char *argv[])
         // make shortcuts system and language independent
         translator2.load(qtTransPrefix + lang, appPath);
         app.installTranslator(&translator2);
+        StartupTimer::phase("translations loaded");
 
-        MainWindow window;
+        MainWindow window(&ctx);
+        // the files of the command line are opened once, not on restarts
+        if (firstWindow) {
+            window.slotProcessArguments(app.arguments(), QDir::currentPath());
+            firstWindow = false;
+        }
+        QObject::connect(&instance, SIGNAL(signalArguments(QStringList, QString)),
+                         &window, SLOT(slotProcessArguments(QStringList, QString)), Qt::QueuedConnection);
         return_from_event_loop_code = app.exec();
 
+        // with -d a restart is logged like a startup
+        StartupTimer::start();
+
     } while( return_from_event_loop_code == RESTART_CODE);
 
     return  return_from_event_loop_code;
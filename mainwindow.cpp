@@ -21,9 +21,9 @@
 
 #include "mainwindow.h"
 
-MainWindow::MainWindow()
+MainWindow::MainWindow(GpgME::GpgContext *ctx)
 {
-    mCtx = new GpgME::GpgContext();
+    mCtx = ctx;
 
     /* get path were app was started */
     setCorner(Qt::BottomLeftCorner, Qt::LeftDockWidgetArea);
@@ -32,17 +32,22 @@ MainWindow::MainWindow()
     edit = new TextEdit();
     setCentralWidget(edit);
 
-    /* the list of Keys available*/
+    /* the list of Keys available, filled when the keys are listed */
     mKeyList = new KeyList(mCtx);
+    if (mCtx->keyListPending()) {
+        connect(mCtx, SIGNAL(signalKeyListRefreshed()), this, SLOT(slotKeysLoaded()));
+    }
 
-    /* List of binary Attachments */
+    /* List of binary Attachments, the dock is created with the first attachment */
     attachmentDockCreated = false;
 
     /* Variable containing if restart is needed */
     this->slotSetRestartNeeded(false);
 
-    keyMgmt = new KeyMgmt(mCtx, this);
-    keyMgmt->hide();
+    /* created when the key management or the import menu is opened */
+    keyMgmt = 0;
+    /* the text operation running in the job pool */
+    mJob = 0;
     /* test attachmentdir for files alll 15s */
     QTimer *timer = new QTimer(this);
     connect(timer, SIGNAL(timeout()), this, SLOT(slotCheckAttachmentFolder()));
@@ -53,6 +58,7 @@ MainWindow::MainWindow()
     createToolBars();
     createStatusBar();
     createDockWindows();
+    StartupTimer::phase("actions, menus and docks created");
 
     connect(edit->tabWidget,SIGNAL(currentChanged(int)),this,SLOT(slotDisableTabActions(int)));
 
@@ -62,17 +68,12 @@ MainWindow::MainWindow()
 
     restoreSettings();
 
-    // open filename if provided as first command line parameter
-    QStringList args = qApp->arguments();
-    if (args.size() > 1) {
-        if (!args[1].startsWith("-")) {
-            if (QFile::exists(args[1]))
-                edit->loadFile(args[1]);
-        }
-    }
+    // the command line is passed by main() with slotProcessArguments()
     edit->curTextPage()->setFocus();
     this->setWindowTitle(qApp->applicationName());
     this->show();
+    StartupTimer::phase("window shown");
+    QTimer::singleShot(0, this, SLOT(slotWindowShown()));
 
     // Show wizard, if the don't show wizard message box wasn't checked
     // and keylist doesn't contain a private key
@@ -121,13 +122,124 @@ void MainWindow::restoreSettings()
     importButton->setToolButtonStyle(buttonStyle);
     fileEncButton->setToolButtonStyle(buttonStyle);
 
-    // Checked Keys
+    // Checked Keys, set when the key list is loaded
     if (settings.value("keys/keySave").toBool()) {
         QStringList keyIds = settings.value("keys/keyList").toStringList();
-        mKeyList->setChecked(&keyIds);
+        if (mCtx->keyListPending()) {
+            mPendingCheckedIds = keyIds;
+        } else {
+            mKeyList->setChecked(&keyIds);
+        }
+    }
+}
+
+void MainWindow::slotKeysLoaded()
+{
+    disconnect(mCtx, SIGNAL(signalKeyListRefreshed()), this, SLOT(slotKeysLoaded()));
+    StartupTimer::phase(QString("%1 keys listed").arg(mCtx->keySnapshot()->size()));
+
+    mKeyList->setChecked(&mPendingCheckedIds);
+    mPendingCheckedIds.clear();
+    statusBar()->showMessage(tr("Ready"),2000);
+
+    QList<QPair<QStringList, QString> > pending = mPendingArguments;
+    mPendingArguments.clear();
+    for (int i = 0; i < pending.size(); i++) {
+        slotProcessArguments(pending.at(i).first, pending.at(i).second);
     }
 }
 
+void MainWindow::slotProcessArguments(QStringList arguments, QString workingDir)
+{
+    // another invocation brings the window to the front
+    if (isMinimized()) {
+        showNormal();
+    }
+    raise();
+    activateWindow();
+
+    QString action = "open";
+    QStringList keys, files;
+    for (int i = 1; i < arguments.size(); i++) {
+        QString arg = arguments.at(i);
+        if (arg == "--decrypt") {
+            action = "decrypt";
+        } else if (arg == "--verify") {
+            action = "verify";
+        } else if (arg == "--encrypt-for" && i + 1 < arguments.size()) {
+            action = "encrypt";
+            keys = arguments.at(++i).split(",", QString::SkipEmptyParts);
+        } else if (!arg.startsWith("-")) {
+            files << QDir(workingDir).absoluteFilePath(arg);
+        }
+    }
+    if (files.isEmpty()) {
+        return;
+    }
+
+    // everything but opening needs the keys
+    if (action != "open" && mCtx->keyListPending()) {
+        mPendingArguments.append(qMakePair(arguments, workingDir));
+        return;
+    }
+
+    if (action == "encrypt") {
+        QStringList keyIds;
+        foreach (QString key, keys) {
+            if (key.contains("@")) {
+                foreach (GpgKey found, mCtx->getKeysByEmail(key)) {
+                    keyIds << found.id;
+                }
+            } else {
+                keyIds << key;
+            }
+        }
+        BatchEncryptionDialog dialog(mCtx, keyIds, files, this);
+        dialog.exec();
+        return;
+    }
+
+    QStringList binaryFiles;
+    foreach (QString fileName, files) {
+        if (!QFile::exists(fileName)) {
+            slotSetStatusBarText(tr("File not found: %1").arg(fileName));
+            continue;
+        }
+        if (action == "decrypt") {
+            // binary messages can't be shown in the editor
+            QFile file(fileName);
+            file.open(QIODevice::ReadOnly);
+            if (!file.read(64 * 1024).contains(GpgConstants::PGP_CRYPT_BEGIN)) {
+                binaryFiles << fileName;
+                continue;
+            }
+        }
+
+        // the empty tab of a new window is used for the first file
+        if (edit->tabCount() == 1 && edit->curTextPage() && edit->curTextPage()->document()->isEmpty()
+                && edit->slotCurPage()->getFilePath().isEmpty()) {
+            edit->loadFile(fileName);
+        } else {
+            edit->openFile(fileName);
+        }
+
+        if (action == "decrypt") {
+            slotDecrypt();
+        } else if (action == "verify") {
+            slotVerify();
+        }
+    }
+    if (!binaryFiles.isEmpty()) {
+        BatchEncryptionDialog dialog(mCtx, QStringList(), binaryFiles, this, true);
+        dialog.exec();
+    }
+}
+
+void MainWindow::slotWindowShown()
+{
+    StartupTimer::phase("event loop started");
+}
+
 void MainWindow::saveSettings()
 {
     // window position and size
@@ -136,7 +248,10 @@ void MainWindow::saveSettings()
     settings.setValue("window/size", size());
 
     // keyid-list of private checked keys
-    if (settings.value("keys/keySave").toBool()) {
+    if (settings.value("keys/keySave").toBool() && mCtx->keyListPending()) {
+        // closed before the keys were there, keep the saved ones
+        settings.setValue("keys/keyList", mPendingCheckedIds);
+    } else if (settings.value("keys/keySave").toBool()) {
         QStringList *keyIds = mKeyList->getPrivateChecked();
         if (!keyIds->isEmpty()) {
             settings.setValue("keys/keyList", *keyIds);
@@ -271,6 +386,12 @@ void MainWindow::createActions()
     encryptAct->setToolTip(tr("Encrypt Message"));
     connect(encryptAct, SIGNAL(triggered()), this, SLOT(slotEncrypt()));
 
+    encryptSignAct = new QAction(tr("Encrypt and Si&gn"), this);
+    encryptSignAct->setIcon(QIcon(":encrypted.png"));
+    encryptSignAct->setShortcut(QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_E));
+    encryptSignAct->setToolTip(tr("Sign and Encrypt Message"));
+    connect(encryptSignAct, SIGNAL(triggered()), this, SLOT(slotEncryptSign()));
+
     decryptAct = new QAction(tr("&Decrypt"), this);
     decryptAct->setIcon(QIcon(":decrypted.png"));
     decryptAct->setShortcut(QKeySequence(Qt::CTRL + Qt::Key_D));
@@ -295,6 +416,10 @@ void MainWindow::createActions()
     fileDecryptAct->setToolTip(tr("Decrypt File"));
     connect(fileDecryptAct, SIGNAL(triggered()), this, SLOT(slotFileDecrypt()));
 
+    batchFileEncryptionAct = new QAction(tr("&Batch Encrypt / Decrypt Files"), this);
+    batchFileEncryptionAct->setToolTip(tr("Encrypt or decrypt all files of a directory"));
+    connect(batchFileEncryptionAct, SIGNAL(triggered()), this, SLOT(slotBatchFileEncryption()));
+
     signAct = new QAction(tr("&Sign"), this);
     signAct->setIcon(QIcon(":signature.png"));
     signAct->setShortcut(QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_I));
@@ -399,6 +524,7 @@ void MainWindow::slotDisableTabActions(int number)
     verifyAct->setDisabled(disable);
     signAct->setDisabled(disable);
     encryptAct->setDisabled(disable);
+    encryptSignAct->setDisabled(disable);
     decryptAct->setDisabled(disable);
 
     redoAct->setDisabled(disable);
@@ -448,6 +574,7 @@ void MainWindow::createMenus()
 
     cryptMenu = menuBar()->addMenu(tr("&Crypt"));
     cryptMenu->addAction(encryptAct);
+    cryptMenu->addAction(encryptSignAct);
     cryptMenu->addAction(decryptAct);
     cryptMenu->addSeparator();
     cryptMenu->addAction(signAct);
@@ -455,15 +582,13 @@ void MainWindow::createMenus()
     cryptMenu->addSeparator();
     cryptMenu->addAction(fileEncryptAct);
     cryptMenu->addAction(fileDecryptAct);
+    cryptMenu->addAction(batchFileEncryptionAct);
 
     keyMenu = menuBar()->addMenu(tr("&Keys"));
     importKeyMenu = keyMenu->addMenu(tr("&Import Key From..."));
     importKeyMenu->setIcon(QIcon(":key_import.png"));
-    importKeyMenu->addAction(keyMgmt->importKeyFromFileAct);
     importKeyMenu->addAction(importKeyFromEditAct);
-    importKeyMenu->addAction(keyMgmt->importKeyFromClipboardAct);
-    importKeyMenu->addAction(keyMgmt->importKeyFromKeyServerAct);
-    importKeyMenu->addAction(keyMgmt->importKeyFromKeyServerAct);
+    connect(importKeyMenu, SIGNAL(aboutToShow()), this, SLOT(slotFillImportKeyMenu()));
     keyMenu->addAction(openKeyManagementAct);
 
     steganoMenu = menuBar()->addMenu(tr("&Steganography"));
@@ -501,6 +626,7 @@ void MainWindow::createToolBars()
     cryptToolBar = addToolBar(tr("Crypt"));
     cryptToolBar->setObjectName("cryptToolBar");
     cryptToolBar->addAction(encryptAct);
+    cryptToolBar->addAction(encryptSignAct);
     cryptToolBar->addAction(decryptAct);
     cryptToolBar->addAction(signAct);
     cryptToolBar->addAction(verifyAct);
@@ -539,6 +665,7 @@ void MainWindow::createToolBars()
     QMenu* fileEncMenu = new QMenu();
     fileEncMenu->addAction(fileEncryptAct);
     fileEncMenu->addAction(fileDecryptAct);
+    fileEncMenu->addAction(batchFileEncryptionAct);
     fileEncButton->setMenu(fileEncMenu);
     fileEncButton->setPopupMode(QToolButton::InstantPopup);
     fileEncButton->setIcon(QIcon(":fileencryption.png"));
@@ -561,7 +688,11 @@ void MainWindow::createStatusBar()
     statusBarIcon->setPixmap(*pixmap);
     statusBar()->insertPermanentWidget(0,statusBarIcon,0);
     statusBarIcon->hide();
-    statusBar()->showMessage(tr("Ready"),2000);
+    if (mCtx->keyListPending()) {
+        statusBar()->showMessage(tr("Loading keys..."));
+    } else {
+        statusBar()->showMessage(tr("Ready"),2000);
+    }
     statusBarBox->setLayout(statusBarBoxLayout);
 }
 
@@ -576,11 +707,8 @@ void MainWindow::createDockWindows()
     keylistDock->setWidget(mKeyList);
     viewMenu->addAction(keylistDock->toggleViewAction());
 
-    /* Attachments-Dockwindow
+    /* Attachments-Dockwindow is created by parseMime()
       */
-    if(settings.value("mime/parseMime").toBool()) {
-        createAttachmentDock();
-    }
 }
 
 void MainWindow::createAttachmentDock() {
@@ -610,6 +738,13 @@ void MainWindow::closeAttachmentDock() {
 
 void MainWindow::closeEvent(QCloseEvent *event)
 {
+    // the running job returns into a slot of the window, stop it first
+    if (mJob) {
+        mJob->cancel();
+        event->ignore();
+        return;
+    }
+
     /*
      * ask to save changes, if there are
      * modified documents in any tab
@@ -694,7 +829,7 @@ void MainWindow::slotSetStatusBarText(QString text)
 
 void MainWindow::slotStartWizard()
 {
-    Wizard *wizard = new Wizard(mCtx,keyMgmt,this);
+    Wizard *wizard = new Wizard(mCtx,keyManagement(),this);
     wizard->show();
     wizard->setModal(true);
 }
@@ -727,6 +862,8 @@ void MainWindow::parseMime(QByteArray *message)
             }
             pText.append(QString(body));
         } else {
+            // only messages with attachments get the dock
+            createAttachmentDock();
             (mAttachments->addMimePart(&tmp));
             showmadock = true;
         }
@@ -766,60 +903,108 @@ void MainWindow::slotImportKeyFromEdit()
         return;
     }
 
-    keyMgmt->slotImportKeys(edit->curTextPage()->toPlainText().toAscii());
+    keyManagement()->slotImportKeys(edit->curTextPage()->toPlainText().toAscii());
 }
 
 void MainWindow::slotOpenKeyManagement()
 {
-    keyMgmt->show();
+    keyManagement()->show();
     keyMgmt->raise();
     keyMgmt->activateWindow();
 }
 
+KeyMgmt *MainWindow::keyManagement()
+{
+    if (!keyMgmt) {
+        keyMgmt = new KeyMgmt(mCtx, this);
+        keyMgmt->hide();
+    }
+    return keyMgmt;
+}
+
+void MainWindow::slotFillImportKeyMenu()
+{
+    disconnect(importKeyMenu, SIGNAL(aboutToShow()), this, SLOT(slotFillImportKeyMenu()));
+    importKeyMenu->insertAction(importKeyFromEditAct, keyManagement()->importKeyFromFileAct);
+    importKeyMenu->addAction(keyMgmt->importKeyFromClipboardAct);
+    importKeyMenu->addAction(keyMgmt->importKeyFromKeyServerAct);
+}
+
 void MainWindow::slotEncrypt()
 {
-    if (edit->tabCount()==0 || edit->slotCurPage() == 0) {
+    if (mJob || edit->tabCount()==0 || edit->slotCurPage() == 0) {
         return;
     }
 
-    QStringList *uidList = mKeyList->getChecked();
+    GpgME::GpgJob *job = new GpgME::GpgJob(mCtx, GpgME::GpgJob::Encrypt);
+    job->setKeys(*mKeyList->getChecked());
+    job->setInput(edit->curTextPage()->toPlainText().toUtf8());
 
-    QByteArray *tmp = new QByteArray();
-    if (mCtx->encrypt(uidList, edit->curTextPage()->toPlainText().toUtf8(), tmp)) {
-        QString *tmp2 = new QString(*tmp);
-        edit->slotFillTextEditWithText(*tmp2);
+    QPointer<EditorPage> page = edit->slotCurPage();
+    if (execJob(job, tr("Encrypting...")) && page) {
+        fillEditorPage(page, QString::fromUtf8(job->output()));
     }
+    delete job;
 }
 
-void MainWindow::slotSign()
+void MainWindow::slotEncryptSign()
 {
-    if (edit->tabCount()==0 || edit->slotCurPage() == 0) {
+    if (mJob || edit->tabCount()==0 || edit->slotCurPage() == 0) {
         return;
     }
 
-    QStringList *uidList = mKeyList->getPrivateChecked();
+    GpgME::GpgJob *job = new GpgME::GpgJob(mCtx, GpgME::GpgJob::EncryptSign);
+    job->setKeys(*mKeyList->getChecked());
+    job->setSigners(*mKeyList->getPrivateChecked());
+    job->setInput(edit->curTextPage()->toPlainText().toUtf8());
+
+    QPointer<EditorPage> page = edit->slotCurPage();
+    if (execJob(job, tr("Encrypting and signing...")) && page) {
+        fillEditorPage(page, QString::fromUtf8(job->output()));
+    }
+    delete job;
+}
+
+void MainWindow::slotSign()
+{
+    if (mJob || edit->tabCount()==0 || edit->slotCurPage() == 0) {
+        return;
+    }
 
-    QByteArray *tmp = new QByteArray();
+    GpgME::GpgJob *job = new GpgME::GpgJob(mCtx, GpgME::GpgJob::Sign);
+    job->setKeys(*mKeyList->getPrivateChecked());
+    job->setInput(edit->curTextPage()->toPlainText().toUtf8());
 
-    if (mCtx->sign(uidList, edit->curTextPage()->toPlainText().toUtf8(), tmp)) {
-        edit->slotFillTextEditWithText(QString::fromUtf8(*tmp));
+    QPointer<EditorPage> page = edit->slotCurPage();
+    if (execJob(job, tr("Signing...")) && page) {
+        fillEditorPage(page, QString::fromUtf8(job->output()));
     }
+    delete job;
 }
 
 void MainWindow::slotDecrypt()
 {
-    if (edit->tabCount()== 0 || edit->slotCurPage() == 0) {
+    if (mJob || edit->tabCount()== 0 || edit->slotCurPage() == 0) {
         return;
     }
 
-    QByteArray *decrypted = new QByteArray();
     QByteArray text = edit->curTextPage()->toPlainText().toAscii(); // TODO: toUtf8() here?
     mCtx->preventNoDataErr(&text);
 
+    // signatures of the message are checked in the same gpg run
+    GpgME::GpgJob *job = new GpgME::GpgJob(mCtx, GpgME::GpgJob::DecryptVerify);
+    job->setInput(text);
+
     // try decrypt, if fail do nothing, especially don't replace text
-    if(!mCtx->decrypt(text, decrypted)) {
+    QPointer<EditorPage> page = edit->slotCurPage();
+    if (!execJob(job, tr("Decrypting...")) || !page) {
+        delete job;
         return;
     }
+    QByteArray *decrypted = new QByteArray(job->output());
+    QStringList signatureFprs = job->signatureFprs();
+    QList<gpgme_error_t> signatureStatus = job->signatureStatus();
+    delete job;
 
     /*
          *   1) is it mime (content-type:)
@@ -842,7 +1027,47 @@ void MainWindow::slotDecrypt()
             }
         }
     }
-    edit->slotFillTextEditWithText(QString::fromUtf8(*decrypted));
+    fillEditorPage(page, QString::fromUtf8(*decrypted));
+
+    if (!signatureFprs.isEmpty()) {
+        page->closeNoteByClass("verifyNotification");
+        VerifyNotification *vn = new VerifyNotification(this, mCtx, mKeyList, page->getTextPage());
+        vn->setDecryptedSignatures(signatureFprs, signatureStatus);
+        page->showNotificationWidget(vn, "verifyNotification");
+    }
+}
+
+/** The window stays responsive while gpg runs, a progress dialog
+ *  shows up for long jobs and allows to cancel them
+ */
+bool MainWindow::execJob(GpgME::GpgJob *job, const QString &labelText)
+{
+    QProgressDialog progress(labelText, tr("Cancel"), 0, 0, this);
+    progress.setWindowModality(Qt::WindowModal);
+    progress.setMinimumDuration(500);
+
+    QEventLoop loop;
+    connect(job, SIGNAL(signalFinished(GpgME::GpgJob*)), &loop, SLOT(quit()));
+    connect(&progress, SIGNAL(canceled()), job, SLOT(cancel()));
+    mJob = job;
+    mCtx->startJob(job);
+    loop.exec();
+    mJob = 0;
+
+    if (!job->success() && !job->isCanceled() && !job->errorString().isEmpty()) {
+        QMessageBox::critical(this, windowTitle(), job->errorString());
+    }
+    return job->success();
+}
+
+void MainWindow::fillEditorPage(EditorPage *page, const QString &text)
+{
+    // the job may have finished after another tab was activated
+    QTextCursor cursor(page->getTextPage()->document());
+    cursor.beginEditBlock();
+    page->getTextPage()->selectAll();
+    page->getTextPage()->insertPlainText(text);
+    cursor.endEditBlock();
 }
 
 void MainWindow::slotFind()
@@ -938,6 +1163,14 @@ void MainWindow::slotFileDecrypt()
         new FileEncryptionDialog(mCtx, *keyList, this, FileEncryptionDialog::Decrypt);
 }
 
+void MainWindow::slotBatchFileEncryption()
+{
+        QStringList *keyList;
+        keyList = mKeyList->getChecked();
+        BatchEncryptionDialog dialog(mCtx, *keyList, QStringList(), this);
+        dialog.exec();
+}
+
 void MainWindow::slotOpenSettingsDialog()
 {
 
@@ -954,10 +1187,8 @@ void MainWindow::slotOpenSettingsDialog()
     importButton->setToolButtonStyle(buttonStyle);
     fileEncButton->setToolButtonStyle(buttonStyle);
 
-    // Mime-settings
-    if(settings.value("mime/parseMime").toBool()) {
-        createAttachmentDock();
-    } else if(attachmentDockCreated) {
+    // Mime-settings, the dock is created with the next attachment
+    if(!settings.value("mime/parseMime").toBool() && attachmentDockCreated) {
         closeAttachmentDock();
     }
 
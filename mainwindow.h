@@ -23,14 +23,17 @@
 #define __GPGWIN_H__
 
 #include "gpgconstants.h"
+#include "gpgjob.h"
 #include "attachments.h"
 #include "keymgmt.h"
 #include "textedit.h"
 #include "fileencryptiondialog.h"
+#include "batchencryptiondialog.h"
 #include "settingsdialog.h"
 #include "verifynotification.h"
 #include "findwidget.h"
 #include "wizard.h"
+#include "startuptimer.h"
 
 QT_BEGIN_NAMESPACE
 class QMainWindow;
@@ -67,13 +70,26 @@ class MainWindow : public QMainWindow
 
 public:
     /**
-     * @brief
-     *
+     * @param ctx The context of the application. It is kept when the window
+     * is rebuilt for a language change, so the keyring isn't listed again.
      */
-    MainWindow();
+    MainWindow(GpgME::GpgContext *ctx);
 public slots:
     void slotSetStatusBarText(QString text);
 
+    /**
+     * @details Handle the command line of this or a later invocation:
+     * "gpg4usb file..." opens the files, "--decrypt file..." and
+     * "--verify file..." open and decrypt or verify them, binary files are
+     * decrypted with the batch dialog. "--encrypt-for keyid,... file..."
+     * opens the batch dialog with the files and keys checked. Key ids can
+     * be given as email addresses.
+     *
+     * @param arguments The arguments, starting with the program name
+     * @param workingDir The directory relative file names are resolved in
+     */
+    void slotProcessArguments(QStringList arguments, QString workingDir);
+
 protected:
     /**
      * @details Close event shows a save dialog, if there are unsaved documents on exit.
@@ -88,6 +104,12 @@ private slots:
      */
     void slotEncrypt();
 
+    /**
+     * @details Sign the text of currently active tab with the checked private keys
+     * and encrypt it for the checked keys in one step
+     */
+    void slotEncryptSign();
+
     /**
      * @details Show a passphrase dialog and decrypt the text of currently active tab.
      */
@@ -155,6 +177,11 @@ private slots:
      */
     void slotFileDecrypt();
 
+    /**
+     * @details Open dialog for encrypting or decrypting many files.
+     */
+    void slotBatchFileEncryption();
+
     /**
      * @details Open settings-dialog.
      */
@@ -200,6 +227,22 @@ private slots:
      */
     void slotAddPgpHeader();
 
+    /**
+     * @details Add the import actions of the key management to the import
+     * menu, when it is shown the first time.
+     */
+    void slotFillImportKeyMenu();
+
+    /**
+     * @details The first key list is there, check the keys saved in the settings.
+     */
+    void slotKeysLoaded();
+
+    /**
+     * @details The event loop runs, the window is painted.
+     */
+    void slotWindowShown();
+
 //    void dropEvent(QDropEvent *event);
 
     /**
@@ -272,6 +315,25 @@ private:
      */
     bool getRestartNeeded();
 
+    /**
+     * @details The key management window, created on first use.
+     */
+    KeyMgmt *keyManagement();
+
+    /**
+     * @details Run job in the job pool of mCtx and wait for it, while the
+     * event loop keeps running. Errors of the job are shown in a messagebox.
+     *
+     * @param labelText Text of the progress dialog
+     * @return true, if the job succeeded. The caller deletes the job
+     */
+    bool execJob(GpgME::GpgJob *job, const QString &labelText);
+
+    /**
+     * @details Replace the text of page with text in one undo step.
+     */
+    void fillEditorPage(EditorPage *page, const QString &text);
+
     TextEdit *edit; /** Tabwidget holding the edit-windows */
     QMenu *fileMenu; /** Submenu for file-operations*/
     QMenu *editMenu; /** Submenu for text-operations*/
@@ -302,6 +364,7 @@ private:
     QAction *closeTabAct; /** Action to print */
     QAction *quitAct; /** Action to quit application */
     QAction *encryptAct; /** Action to encrypt text */
+    QAction *encryptSignAct; /** Action to encrypt and sign text */
     QAction *decryptAct; /** Action to decrypt text */
     QAction *signAct; /** Action to sign text */
     QAction *verifyAct; /** Action to verify text */
@@ -325,6 +388,7 @@ private:
     QAction *fileEncryptionAct; /** Action to open file-encryption dialog */
     QAction *fileEncryptAct; /** Action to open dialog for encrypting file */
     QAction *fileDecryptAct; /** Action to open dialog for decrypting file */
+    QAction *batchFileEncryptionAct; /** Action to open dialog for en/decrypting many files */
     QAction *openSettingsAct; /** Action to open settings dialog */
     QAction *openTranslateAct; /** Action to open translate doc*/
     QAction *openTutorialAct; /** Action to open tutorial */
@@ -338,10 +402,13 @@ private:
     QSettings settings; /**< TODO */
     KeyList *mKeyList; /**< TODO */
     Attachments *mAttachments; /**< TODO */
-    GpgME::GpgContext *mCtx; /**< TODO */
-    KeyMgmt *keyMgmt; /**< TODO */
+    GpgME::GpgContext *mCtx; /** owned by main(), outlives the window */
+    KeyMgmt *keyMgmt; /** 0 until keyManagement() is called */
+    GpgME::GpgJob *mJob; /** the running text operation, 0 if none */
     KeyServerImportDialog *importDialog; /**< TODO */
     bool attachmentDockCreated;
+    QStringList mPendingCheckedIds; /** keys to check once the key list is loaded */
+    QList<QPair<QStringList, QString> > mPendingArguments; /** requests waiting for the key list */
     bool restartNeeded;
 };
 
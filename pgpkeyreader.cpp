@@ -0,0 +1,257 @@
+/*
+ *      pgpkeyreader.cpp
+ *
+ *      Copyright 2008 gpg4usb-team <gpg4usb@cpunk.de>
+ *
+ *      This file is part of gpg4usb.
+ *
+ *      Gpg4usb is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      Gpg4usb is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with gpg4usb.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "pgpkeyreader.h"
+#include <QIODevice>
+#include <QCryptographicHash>
+
+/** packet tags starting a key, RFC 4880 4.3 */
+static const int SECRET_KEY_PACKET = 5;
+static const int PUBLIC_KEY_PACKET = 6;
+
+/** larger packets aren't key material, the data is garbage */
+static const qint64 MAX_PACKET_LENGTH = 16 * 1024 * 1024;
+
+PgpKeyReader::PgpKeyReader(QIODevice *device)
+{
+    mDevice = device;
+    mPendingTag = 0;
+    mPendingBodyOffset = 0;
+    mKeyTag = 0;
+    mKeyBodyOffset = 0;
+    mError = false;
+}
+
+bool PgpKeyReader::isBinary(QIODevice *device)
+{
+    QByteArray start = device->peek(1);
+    return start.size() == 1 && (start.at(0) & 0x80);
+}
+
+bool PgpKeyReader::hasError() const
+{
+    return mError;
+}
+
+bool PgpKeyReader::readKey(QByteArray *key)
+{
+    QByteArray packet;
+    int tag, bodyOffset;
+
+    key->clear();
+    mKeyPacket.clear();
+    if (!mPending.isEmpty()) {
+        mKeyPacket = mPending;
+        mKeyTag = mPendingTag;
+        mKeyBodyOffset = mPendingBodyOffset;
+        mPending.clear();
+    } else {
+        // skip anything before the first key, like a leading trust packet
+        do {
+            if (!readPacket(&packet, &tag, &bodyOffset)) {
+                return false;
+            }
+        } while (tag != SECRET_KEY_PACKET && tag != PUBLIC_KEY_PACKET);
+        mKeyPacket = packet;
+        mKeyTag = tag;
+        mKeyBodyOffset = bodyOffset;
+    }
+    *key = mKeyPacket;
+
+    while (readPacket(&packet, &tag, &bodyOffset)) {
+        if (tag == SECRET_KEY_PACKET || tag == PUBLIC_KEY_PACKET) {
+            mPending = packet;
+            mPendingTag = tag;
+            mPendingBodyOffset = bodyOffset;
+            return true;
+        }
+        key->append(packet);
+    }
+    return !mError;
+}
+
+bool PgpKeyReader::isSecret() const
+{
+    return mKeyTag == SECRET_KEY_PACKET;
+}
+
+/** v4 fingerprint, SHA-1 over 0x99, the two byte length and
+ *  the public part of the key packet, RFC 4880 12.2
+ */
+QString PgpKeyReader::fingerprint() const
+{
+    QByteArray body = mKeyPacket.mid(mKeyBodyOffset);
+    if (body.isEmpty() || body.at(0) != 4) {
+        return QString();
+    }
+
+    int length = isSecret() ? publicKeyLength(body) : body.size();
+    if (length < 0 || length > 0xffff) {
+        return QString();
+    }
+    QByteArray hashed;
+    hashed.append((char)0x99);
+    hashed.append((char)(length >> 8));
+    hashed.append((char)(length & 0xff));
+    hashed.append(body.left(length));
+    return QString(QCryptographicHash::hash(hashed, QCryptographicHash::Sha1).toHex().toUpper());
+}
+
+/** Length of the public key part at the start of a v4 secret key
+ *  packet: version, creation time, algorithm and the public key fields
+ *  of the algorithm. -1 if the algorithm is unknown or body too short.
+ */
+int PgpKeyReader::publicKeyLength(const QByteArray &body)
+{
+    if (body.size() < 6) {
+        return -1;
+    }
+    int algorithm = (uchar)body.at(5);
+    int pos = 6;
+    int mpis;
+    bool oid = false, kdf = false;
+
+    switch (algorithm) {
+    case 1: case 2: case 3: // RSA: n, e
+        mpis = 2;
+        break;
+    case 16: case 20: // Elgamal: p, g, y
+        mpis = 3;
+        break;
+    case 17: // DSA: p, q, g, y
+        mpis = 4;
+        break;
+    case 19: case 22: // ECDSA, EdDSA: curve oid, point
+        oid = true;
+        mpis = 1;
+        break;
+    case 18: // ECDH: curve oid, point, kdf parameters
+        oid = true;
+        mpis = 1;
+        kdf = true;
+        break;
+    default:
+        return -1;
+    }
+
+    if (oid) {
+        if (pos >= body.size()) {
+            return -1;
+        }
+        pos += 1 + (uchar)body.at(pos);
+    }
+    for (int i = 0; i < mpis; i++) {
+        if (pos + 2 > body.size()) {
+            return -1;
+        }
+        int bits = ((uchar)body.at(pos) << 8) | (uchar)body.at(pos + 1);
+        pos += 2 + (bits + 7) / 8;
+    }
+    if (kdf) {
+        if (pos >= body.size()) {
+            return -1;
+        }
+        pos += 1 + (uchar)body.at(pos);
+    }
+    return pos <= body.size() ? pos : -1;
+}
+
+/** Read one packet with its header, RFC 4880 4.2
+ */
+bool PgpKeyReader::readPacket(QByteArray *packet, int *tag, int *bodyOffset)
+{
+    char c;
+    if (!mDevice->getChar(&c)) {
+        return false;
+    }
+    uchar ctb = c;
+    if (!(ctb & 0x80)) {
+        mError = true;
+        return false;
+    }
+
+    QByteArray header(1, c);
+    qint64 length = 0;
+    int lengthBytes;
+    if (ctb & 0x40) {
+        // new format, the first length octet tells the size of the length
+        *tag = ctb & 0x3f;
+        QByteArray first = mDevice->read(1);
+        if (first.size() != 1) {
+            mError = true;
+            return false;
+        }
+        header.append(first);
+        uchar octet = first.at(0);
+        if (octet < 192) {
+            length = octet;
+            lengthBytes = 0;
+        } else if (octet < 224) {
+            length = ((octet - 192) << 8) + 192;
+            lengthBytes = 1;
+        } else if (octet == 255) {
+            lengthBytes = 4;
+        } else {
+            // partial body lengths are only used for data packets
+            mError = true;
+            return false;
+        }
+    } else {
+        *tag = (ctb >> 2) & 0x0f;
+        switch (ctb & 0x03) {
+        case 0: lengthBytes = 1; break;
+        case 1: lengthBytes = 2; break;
+        case 2: lengthBytes = 4; break;
+        default:
+            // indeterminate length, not used for keys
+            mError = true;
+            return false;
+        }
+    }
+
+    if (lengthBytes > 0) {
+        QByteArray bytes = mDevice->read(lengthBytes);
+        if (bytes.size() != lengthBytes) {
+            mError = true;
+            return false;
+        }
+        header.append(bytes);
+        qint64 value = 0;
+        for (int i = 0; i < lengthBytes; i++) {
+            value = (value << 8) | (uchar)bytes.at(i);
+        }
+        // a one byte new format length adds to the first octet
+        length = (lengthBytes == 1 && (ctb & 0x40)) ? length + value : value;
+    }
+
+    if (length > MAX_PACKET_LENGTH) {
+        mError = true;
+        return false;
+    }
+    QByteArray body = mDevice->read(length);
+    if (body.size() != length) {
+        mError = true;
+        return false;
+    }
+    *packet = header + body;
+    *bodyOffset = header.size();
+    return true;
+}
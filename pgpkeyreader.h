@@ -0,0 +1,85 @@
+/*
+ *      pgpkeyreader.h
+ *
+ *      Copyright 2008 gpg4usb-team <gpg4usb@cpunk.de>
+ *
+ *      This file is part of gpg4usb.
+ *
+ *      Gpg4usb is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      Gpg4usb is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with gpg4usb.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef __PGPKEYREADER_H__
+#define __PGPKEYREADER_H__
+
+#include <QByteArray>
+#include <QString>
+
+QT_BEGIN_NAMESPACE
+class QIODevice;
+QT_END_NAMESPACE
+
+/**
+ * @brief Splits binary OpenPGP key data, e.g. a pubring.gpg, into single keys
+ *
+ * @details Only the packet headers are parsed. A key starts with a public or
+ * secret key packet and includes all following packets up to the next key.
+ * Armored data isn't handled, check isBinary() first.
+ */
+class PgpKeyReader
+{
+public:
+    explicit PgpKeyReader(QIODevice *device);
+
+    /**
+     * @details The first byte of binary OpenPGP data has the high bit set,
+     * armored data starts with text.
+     */
+    static bool isBinary(QIODevice *device);
+
+    /**
+     * @details Read the next key with all its packets.
+     *
+     * @return false at the end of the data or if a packet is malformed
+     */
+    bool readKey(QByteArray *key);
+    /**
+     * @details A malformed or truncated packet was found.
+     */
+    bool hasError() const;
+
+    /**
+     * @details Fingerprint of the last key read, computed from its key packet
+     * like gpg does. Empty for old v3 keys and unknown algorithms.
+     */
+    QString fingerprint() const;
+    /**
+     * @details The last key read is a secret key.
+     */
+    bool isSecret() const;
+
+private:
+    bool readPacket(QByteArray *packet, int *tag, int *bodyOffset);
+    static int publicKeyLength(const QByteArray &body);
+
+    QIODevice *mDevice;
+    QByteArray mPending; /** first packet of the next key */
+    int mPendingTag;
+    int mPendingBodyOffset;
+    QByteArray mKeyPacket; /** key packet of the last key read */
+    int mKeyTag;
+    int mKeyBodyOffset;
+    bool mError;
+};
+
+#endif // __PGPKEYREADER_H__
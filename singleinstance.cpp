@@ -0,0 +1,116 @@
+/*
+ *      singleinstance.cpp
+ *
+ *      Copyright 2008 gpg4usb-team <gpg4usb@cpunk.de>
+ *
+ *      This file is part of gpg4usb.
+ *
+ *      Gpg4usb is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      Gpg4usb is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with gpg4usb.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "singleinstance.h"
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QLocalServer>
+#include <QLocalSocket>
+
+/** A request is the size of the rest as quint32, the working
+ *  directory and the arguments. The answer is a single byte
+ */
+SingleInstance::SingleInstance(QObject *parent)
+        : QObject(parent)
+{
+    QByteArray user = qgetenv("USER");
+    if (user.isEmpty()) {
+        user = qgetenv("USERNAME");
+    }
+    QByteArray id = QCoreApplication::applicationDirPath().toUtf8() + '\n' + user;
+    mName = "gpg4usb-" + QCryptographicHash::hash(id, QCryptographicHash::Sha1).toHex().left(16);
+    mServer = new QLocalServer(this);
+    connect(mServer, SIGNAL(newConnection()), this, SLOT(slotNewConnection()));
+}
+
+bool SingleInstance::forward(const QStringList &arguments, const QString &workingDir)
+{
+    QLocalSocket socket;
+    socket.connectToServer(mName);
+    if (!socket.waitForConnected(500)) {
+        return false;
+    }
+
+    QByteArray block;
+    QDataStream out(&block, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_0);
+    out << (quint32)0 << workingDir << arguments;
+    out.device()->seek(0);
+    out << (quint32)(block.size() - sizeof(quint32));
+    socket.write(block);
+
+    // a hanging instance doesn't keep this one from starting
+    if (!socket.waitForBytesWritten(1000) || !socket.waitForReadyRead(2000)) {
+        return false;
+    }
+    return socket.read(1) == "1";
+}
+
+bool SingleInstance::listen()
+{
+    if (mServer->listen(mName)) {
+        return true;
+    }
+    if (mServer->serverError() == QAbstractSocket::AddressInUseError) {
+        QLocalServer::removeServer(mName);
+        return mServer->listen(mName);
+    }
+    return false;
+}
+
+void SingleInstance::slotNewConnection()
+{
+    while (QLocalSocket *socket = mServer->nextPendingConnection()) {
+        connect(socket, SIGNAL(readyRead()), this, SLOT(slotReadRequest()));
+        connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+    }
+}
+
+void SingleInstance::slotReadRequest()
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket *>(sender());
+    if (!socket) {
+        return;
+    }
+
+    // wait for the whole request
+    quint32 size;
+    QByteArray header = socket->peek(sizeof(quint32));
+    if (header.size() < (int)sizeof(quint32)) {
+        return;
+    }
+    QDataStream(header) >> size;
+    if (socket->bytesAvailable() < (qint64)(sizeof(quint32) + size)) {
+        return;
+    }
+
+    QString workingDir;
+    QStringList arguments;
+    QDataStream in(socket);
+    in.setVersion(QDataStream::Qt_4_0);
+    in >> size >> workingDir >> arguments;
+
+    socket->write("1");
+    socket->flush();
+    socket->disconnectFromServer();
+    emit signalArguments(arguments, workingDir);
+}
@@ -0,0 +1,71 @@
+/*
+ *      singleinstance.h
+ *
+ *      Copyright 2008 gpg4usb-team <gpg4usb@cpunk.de>
+ *
+ *      This file is part of gpg4usb.
+ *
+ *      Gpg4usb is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      Gpg4usb is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with gpg4usb.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef __SINGLEINSTANCE_H__
+#define __SINGLEINSTANCE_H__
+
+#include <QObject>
+#include <QStringList>
+
+QT_BEGIN_NAMESPACE
+class QLocalServer;
+QT_END_NAMESPACE
+
+/**
+ * @brief Passes the command line of later invocations to the running gpg4usb
+ *
+ * @details The first instance listens on a local socket, named after the
+ * application path and the user, so every copy of gpg4usb on a stick has its
+ * own. Later invocations send their arguments and working directory there
+ * and exit, the running instance emits them as signalArguments.
+ */
+class SingleInstance : public QObject
+{
+    Q_OBJECT
+
+public:
+    SingleInstance(QObject *parent = 0);
+
+    /**
+     * @details Send arguments to the running instance.
+     *
+     * @return true, if an instance took them, false if none is running
+     */
+    bool forward(const QStringList &arguments, const QString &workingDir);
+    /**
+     * @details Become the running instance. A socket left over by a crashed
+     * instance is removed.
+     */
+    bool listen();
+
+signals:
+    void signalArguments(QStringList arguments, QString workingDir);
+
+private slots:
+    void slotNewConnection();
+    void slotReadRequest();
+
+private:
+    QString mName;
+    QLocalServer *mServer;
+};
+
+#endif // __SINGLEINSTANCE_H__
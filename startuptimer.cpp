@@ -1,5 +1,5 @@
 /*
- *      keygenthread.cpp
+ *      startuptimer.cpp
  *
  *      Copyright 2008 gpg4usb-team <gpg4usb@cpunk.de>
  *
@@ -19,16 +19,38 @@
  *      along with gpg4usb.  If not, see <http://www.gnu.org/licenses/>
  */
 
-#include "keygenthread.h"
+#include "startuptimer.h"
+#include <QCoreApplication>
+#include <QStringList>
+#include <QDebug>
 
-KeyGenThread::KeyGenThread(QString keyGenParams, GpgME::GpgContext *ctx)
+QTime StartupTimer::sTime;
+int StartupTimer::sLast = 0;
+int StartupTimer::sEnabled = -1;
+
+void StartupTimer::start()
 {
-    this->keyGenParams = keyGenParams;
-    this->mCtx = ctx;
-    abort = false;
+    sTime.start();
+    sLast = 0;
 }
 
-void KeyGenThread::run()
+void StartupTimer::phase(const QString &name)
+{
+    if (!enabled()) {
+        return;
+    }
+    int elapsed = sTime.elapsed();
+    qDebug() << qPrintable(QString("startup: %1 %2 ms (+%3 ms)").arg(name).arg(elapsed).arg(elapsed - sLast));
+    sLast = elapsed;
+}
+
+/** The arguments are known once the application
+ *  object exists
+ */
+bool StartupTimer::enabled()
 {
-    mCtx->generateKey(&keyGenParams);
+    if (sEnabled < 0 && QCoreApplication::instance()) {
+        sEnabled = QCoreApplication::arguments().contains("-d") ? 1 : 0;
+    }
+    return sEnabled > 0;
 }
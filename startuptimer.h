@@ -1,5 +1,5 @@
 /*
- *      keygenthread.h
+ *      startuptimer.h
  *
  *      Copyright 2008 gpg4usb-team <gpg4usb@cpunk.de>
  *
@@ -19,38 +19,38 @@
  *      along with gpg4usb.  If not, see <http://www.gnu.org/licenses/>
  */
 
-#ifndef __KEYGENTHREAD_H__
-#define __KEYGENTHREAD_H__
+#ifndef __STARTUPTIMER_H__
+#define __STARTUPTIMER_H__
 
-#include "gpgcontext.h"
-#include <qthread.h>
-#include <iostream>
-#include <string>
-#include <cmath>
-#include <QtGui>
+#include <QTime>
 
-QT_BEGIN_NAMESPACE
-class QMessageBox;
-QT_END_NAMESPACE
+class QString;
 
-class KeyGenThread : public QThread
+/**
+ * @brief Logs how long the phases of the startup take
+ *
+ * @details Only active when gpg4usb is called with -d. Every phase is logged
+ * with the time since start() and since the phase before, e.g.
+ * "startup: window shown 412 ms (+25 ms)".
+ */
+class StartupTimer
 {
-    Q_OBJECT
-
 public:
-    KeyGenThread(QString keyGenParams, GpgME::GpgContext *ctx);
-
-signals:
-    void signalKeyGenerated();
+    /**
+     * @details Start the clock, called first thing in main().
+     */
+    static void start();
+    /**
+     * @details Log the end of phase name.
+     */
+    static void phase(const QString &name);
 
 private:
-    QString keyGenParams;
-    GpgME::GpgContext *mCtx;
-    bool abort;
-    QMutex mutex;
-
-protected:
-    void run();
+    static bool enabled();
 
+    static QTime sTime;
+    static int sLast; /** elapsed ms at the last phase */
+    static int sEnabled; /** -1 until the arguments were checked */
 };
-#endif // __KEYGENTHREAD_H__
+
+#endif // __STARTUPTIMER_H__
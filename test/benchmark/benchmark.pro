@@ -0,0 +1,42 @@
+######################################################################
+# benchmarks of the GpgContext operations, run ./benchmark in test/
+# results are written to benchmark-results.csv and .json
+######################################################################
+
+CONFIG += qtestlib
+TEMPLATE = app
+TARGET = benchmark
+DEPENDPATH += .
+INCLUDEPATH += . ..
+# next to the test, so the gpg binary in test/bin is used
+DESTDIR = ..
+
+# Input
+SOURCES += benchmarkgpgcontext.cpp \
+           ../keyringgenerator.cpp \
+           ../../gpgcontext.cpp \
+           ../../gpgconstants.cpp \
+           ../../gpgjob.cpp \
+           ../../gpgbatch.cpp \
+           ../../gpgprocess.cpp \
+           ../../gpgkeystore.cpp \
+           ../../keyimportdetaildialog.cpp \
+           ../../keylist.cpp \
+           ../../keylistmodel.cpp \
+           ../../keysearchindex.cpp \
+           ../../pgpkeyreader.cpp
+HEADERS += ../keyringgenerator.h \
+           ../../gpgcontext.h \
+           ../../gpgconstants.h \
+           ../../gpgjob.h \
+           ../../gpgbatch.h \
+           ../../gpgprocess.h \
+           ../../gpgkeystore.h \
+           ../../keyimportdetaildialog.h \
+           ../../keylist.h \
+           ../../keylistmodel.h \
+           ../../keysearchindex.h \
+           ../../pgpkeyreader.h
+
+LIBS += -lgpgme \
+     -lgpg-error \
@@ -0,0 +1,1063 @@
+#include <QObject>
+#include <QtTest/QtTest>
+#include <../../gpgcontext.h>
+#include <../../gpgconstants.h>
+#include <../../gpgkeystore.h>
+#include <../../keysearchindex.h>
+#include <../../gpgprocess.h>
+#include <../../gpgbatch.h>
+#include <../../keylist.h>
+#include <../../keylistmodel.h>
+#include <../../pgpkeyreader.h>
+#include "keyringgenerator.h"
+
+/**
+* benchmarks of the GpgContext operations against a temporary keydb,
+* so they don't depend on or change the keydb of the unit test.
+*
+* GPG4USB_BENCH_MAX_SIZE    largest payload in bytes, default 64 MB,
+*                           1073741824 adds the 1 GB rows
+* GPG4USB_BENCH_KEYS        number of generated keys the keydb starts
+*                           with, e.g. 1000, 10000 or 100000, default 0.
+*                           They have up to 3 uids, 10% are expired and
+*                           5% revoked
+* GPG4USB_BENCH_KEYRING     keyring file imported before the benchmarks,
+*                           e.g. the production keyring
+* GPG4USB_BENCH_RESULTS     base name of the result files, default
+*                           benchmark-results (.csv and .json)
+*/
+class BenchmarkGpgContext : public QObject
+{
+    Q_OBJECT
+
+public:
+	BenchmarkGpgContext();
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void encrypt_data();
+    void encrypt();
+    void decrypt_data();
+    void decrypt();
+    void sign_data();
+    void sign();
+    void verify_data();
+    void verify();
+    void encryptFile_data();
+    void encryptFile();
+    void decryptFile_data();
+    void decryptFile();
+    void importKey_data();
+    void importKey();
+    void importKeyring();
+    void importOverlap_data();
+    void importOverlap();
+    void listKeys();
+    void keyListModel();
+    void restart_data();
+    void restart();
+    void exportKeys_data();
+    void exportKeys();
+    void keySearchBuild();
+    void keySearchQuery_data();
+    void keySearchQuery();
+    void encryptRecipients_data();
+    void encryptRecipients();
+    void encryptBatch();
+    void encryptMultiFile_data();
+    void encryptMultiFile();
+    void encryptFileArmor_data();
+    void encryptFileArmor();
+    void encryptSign_data();
+    void encryptSign();
+    void bufferCopies_data();
+    void bufferCopies();
+
+private:
+    struct Result {
+        QString operation;
+        qint64 size;
+        int recipients;
+        int keyringSize;
+        int iterations;
+        int msecs;
+        int heapAllocations;
+        qint64 heapBytes;
+        qint64 copiedBytes;
+    };
+
+    void record(const QString &operation, qint64 size, int recipients, int msecs, int iterations,
+                int heapAllocations = 0, qint64 heapBytes = 0, qint64 copiedBytes = 0);
+    void writeResults();
+    void addSizeRows(qint64 limit);
+    QStringList recipients(int count) const;
+
+	GpgME::GpgContext* mCtx;
+    QString mKeyDir;
+    QString mKeyringFile; /** the generated keys as keyring file */
+    int mGeneratedKeys;
+    QStringList mRecipientIds; /** generated keys, the test key first */
+    int mKeyringSize;
+    qint64 mMaxSize;
+    QVariant mRememberPassword; /** setting restored after the benchmarks */
+    QList<Result> mResults;
+};
+
+/** the test key, its passphrase is "x" */
+static const char *testKeyId = "AF82244F9CD9FD55";
+/** generated keys to encrypt for */
+static const int recipientCounts[] = { 1, 10, 50 };
+/** buffer operations hold in- and output in memory */
+static const qint64 bufferLimit = Q_INT64_C(256) * 1024 * 1024;
+
+/**
+* deterministic, incompressible payload, so gpg's compression
+* doesn't hide the cost of the encryption
+*/
+static QByteArray payload(int size) {
+        QByteArray data(size, 0);
+        qsrand(size);
+        for (int i = 0; i + 1 < size; i += 2) {
+            int r = qrand();
+            data[i] = (char)(r & 0xff);
+            data[i + 1] = (char)((r >> 8) & 0xff);
+        }
+        return data;
+}
+
+/**
+* text payload for signing, lines of printable characters
+*/
+static QByteArray textPayload(int size) {
+        QByteArray line("a line of a message to sign, long enough to be a typical one\n");
+        QByteArray data;
+        data.reserve(size + line.size());
+        while (data.size() < size) {
+            data += line;
+        }
+        data.truncate(size);
+        return data;
+}
+
+/**
+* in memory store with count generated keys, for the search index
+*/
+static GpgKeyStore syntheticStore(int count) {
+        static const char *names[] = { "Alice", "Bob", "Carol", "Dave", "Eve", "Frank", "Grace", "Heidi" };
+        GpgKeyStore store;
+        store.reserve(count);
+        for (int i = 0; i < count; i++) {
+            GpgKey key;
+            QString hex = QString("%1").arg(i, 8, 16, QChar('0')).toUpper();
+            key.name = QString("%1 Tester%2").arg(names[i % 8]).arg(i);
+            key.email = QString("%1.%2@example%3.org").arg(names[i % 8]).arg(i).arg(i % 100).toLower();
+            key.id = "DEADBEEF" + hex;
+            key.fpr = "0123456789ABCDEF01234567" + key.id;
+            key.subkeyIds << key.id;
+            key.subkeyFprs << key.fpr;
+            store.insert(key);
+        }
+        return store;
+}
+
+static void writePayloadFile(const QString &fileName, qint64 size) {
+        const int block = 1024 * 1024;
+        QFile file(fileName);
+        file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+        QByteArray data = payload(block);
+        for (qint64 written = 0; written < size; written += block) {
+            file.write(data.constData(), qMin(Q_INT64_C(1024) * 1024, size - written));
+        }
+}
+
+static void removeDir(const QString &path) {
+        QDir dir(path);
+        foreach (QString file, dir.entryList(QDir::Files | QDir::Hidden | QDir::System)) {
+            dir.remove(file);
+        }
+        QDir().rmdir(path);
+}
+
+#if defined(Q_OS_LINUX) && defined(__GLIBC__)
+#include <malloc.h>
+
+/**
+* heap usage of the whole process while counting is on, the allocator
+* of glibc is wrapped. Bytes copied are counted, when realloc moves a
+* block, it copies the old block up to the new size.
+*/
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+}
+
+static volatile int sHeapCounting = 0;
+static volatile int sHeapAllocations = 0;
+static volatile qint64 sHeapBytes = 0;
+static volatile qint64 sHeapCopied = 0;
+
+static void countAllocation(size_t size) {
+        if (sHeapCounting) {
+            __sync_fetch_and_add(&sHeapAllocations, 1);
+            __sync_fetch_and_add(&sHeapBytes, (qint64)size);
+        }
+}
+
+extern "C" void *malloc(size_t size) {
+        countAllocation(size);
+        return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) {
+        countAllocation(count * size);
+        return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size) {
+        size_t oldSize = (sHeapCounting && ptr) ? malloc_usable_size(ptr) : 0;
+        countAllocation(size);
+        void *result = __libc_realloc(ptr, size);
+        if (oldSize > 0 && result && result != ptr) {
+            __sync_fetch_and_add(&sHeapCopied, (qint64)qMin(oldSize, size));
+        }
+        return result;
+}
+
+static void startHeapCount() {
+        sHeapAllocations = 0;
+        sHeapBytes = 0;
+        sHeapCopied = 0;
+        sHeapCounting = 1;
+}
+
+static void stopHeapCount() {
+        sHeapCounting = 0;
+}
+#endif
+
+/**
+* answers the passphrase dialog with the password of the test key
+*/
+class PassphraseAnswer : public QObject {
+public:
+        PassphraseAnswer() { startTimer(20); }
+protected:
+        void timerEvent(QTimerEvent *) {
+            QInputDialog *dialog = qobject_cast<QInputDialog *>(QApplication::activeModalWidget());
+            if (dialog) {
+                dialog->setTextValue("x");
+                dialog->accept();
+            }
+        }
+};
+
+BenchmarkGpgContext::BenchmarkGpgContext() {
+	mCtx = 0;
+    mKeyringSize = 0;
+    mGeneratedKeys = qgetenv("GPG4USB_BENCH_KEYS").toInt();
+    mMaxSize = qgetenv("GPG4USB_BENCH_MAX_SIZE").toLongLong();
+    if (mMaxSize <= 0) {
+        mMaxSize = Q_INT64_C(64) * 1024 * 1024;
+    }
+}
+
+/**
+* create the temporary keydb with the generated keys of
+* GPG4USB_BENCH_KEYS, the test key and the recipient keys, and import
+* the keyring of GPG4USB_BENCH_KEYRING
+*/
+void BenchmarkGpgContext::initTestCase() {
+        mKeyDir = QDir::tempPath() + QString("/gpg4usb-benchmark-%1").arg(QCoreApplication::applicationPid());
+        QVERIFY(QDir().mkpath(mKeyDir));
+
+        if (mGeneratedKeys > 0) {
+            KeyringGenerator generator;
+            generator.setKeyCount(mGeneratedKeys);
+            generator.setExpiredPercent(10);
+            generator.setRevokedPercent(5);
+            QTime time;
+            time.start();
+            QVERIFY(generator.writeKeyDB(mKeyDir));
+            qDebug() << "generated" << mGeneratedKeys << "keys in" << time.elapsed() << "ms";
+
+            // the same keys once more for the import benchmark
+            mKeyringFile = mKeyDir + "-keyring.gpg";
+            QFile keyringFile(mKeyringFile);
+            QVERIFY(keyringFile.open(QIODevice::WriteOnly | QIODevice::Truncate));
+            QVERIFY(generator.write(&keyringFile));
+        }
+        mCtx = new GpgME::GpgContext(mKeyDir);
+
+        QFile file("../testdata/seckey-1.asc");
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        mCtx->importKey(file.readAll());
+
+        // one gpg run for all recipient keys, small keys with quick
+        // random, they are only encrypted for
+        QString params;
+        for (int i = 1; i < recipientCounts[2]; i++) {
+            params += QString("Key-Type: RSA\n"
+                              "Key-Length: 1024\n"
+                              "Key-Usage: encrypt\n"
+                              "Name-Real: Recipient %1\n"
+                              "Name-Email: recipient%1@example.org\n"
+                              "Expire-Date: 0\n"
+                              "%commit\n").arg(i);
+        }
+        GpgME::GpgProcess gpg(qApp->applicationDirPath() + "/bin/gpg", mKeyDir);
+        gpg.start(QStringList() << "--quick-random" << "--gen-key", params.toUtf8());
+        QVERIFY2(gpg.waitForFinished(), qPrintable(gpg.errorString()));
+
+        QByteArray keyring = qgetenv("GPG4USB_BENCH_KEYRING");
+        if (!keyring.isEmpty()) {
+            QFile keyringFile(QString::fromLocal8Bit(keyring));
+            QVERIFY(keyringFile.open(QIODevice::ReadOnly));
+            mCtx->importKeyFile(&keyringFile);
+        }
+
+        mRecipientIds << testKeyId;
+        GpgKeyList keys = mCtx->listKeys();
+        foreach (GpgKey key, keys) {
+            if (key.name.startsWith("Recipient ")) {
+                mRecipientIds << key.id;
+            }
+        }
+        mKeyringSize = keys.size();
+        QVERIFY(mRecipientIds.size() >= recipientCounts[2]);
+
+        // the password is asked once, then only gpg is measured
+        QSettings settings;
+        mRememberPassword = settings.value("general/rememberPassword");
+        settings.setValue("general/rememberPassword", true);
+        qDebug() << "keydb" << mKeyDir << "with" << mKeyringSize << "keys";
+}
+
+void BenchmarkGpgContext::cleanupTestCase() {
+        writeResults();
+        QSettings settings;
+        settings.setValue("general/rememberPassword", mRememberPassword);
+        mCtx->clearPasswordCache();
+        delete mCtx;
+        mCtx = 0;
+        removeDir(mKeyDir);
+        if (!mKeyringFile.isEmpty()) {
+            QFile::remove(mKeyringFile);
+        }
+}
+
+QStringList BenchmarkGpgContext::recipients(int count) const {
+        return mRecipientIds.mid(0, count);
+}
+
+void BenchmarkGpgContext::record(const QString &operation, qint64 size, int recipients, int msecs, int iterations,
+                                 int heapAllocations, qint64 heapBytes, qint64 copiedBytes) {
+        Result result;
+        result.operation = operation;
+        result.size = size;
+        result.recipients = recipients;
+        result.keyringSize = mKeyringSize;
+        result.iterations = qMax(1, iterations);
+        result.msecs = msecs;
+        result.heapAllocations = heapAllocations;
+        result.heapBytes = heapBytes;
+        result.copiedBytes = copiedBytes;
+        mResults.append(result);
+}
+
+/**
+* one line per measured row, msecs per iteration and throughput
+*/
+void BenchmarkGpgContext::writeResults() {
+        QString baseName = QString::fromLocal8Bit(qgetenv("GPG4USB_BENCH_RESULTS"));
+        if (baseName.isEmpty()) {
+            baseName = "benchmark-results";
+        }
+
+        QFile csv(baseName + ".csv");
+        QFile json(baseName + ".json");
+        if (!csv.open(QIODevice::WriteOnly | QIODevice::Truncate) || !json.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qWarning() << "can't write" << baseName;
+            return;
+        }
+        QTextStream csvOut(&csv);
+        QTextStream jsonOut(&json);
+
+        csvOut << "operation,payload_bytes,recipients,keyring_keys,iterations,msecs,mb_per_s,"
+                  "heap_allocations,heap_bytes,copied_bytes\n";
+        jsonOut << "{\n"
+                << "  \"qt\": \"" << qVersion() << "\",\n"
+                << "  \"gpgme\": \"" << GpgME::GpgContext::getGpgmeVersion() << "\",\n"
+                << "  \"date\": \"" << QDateTime::currentDateTime().toString(Qt::ISODate) << "\",\n"
+                << "  \"results\": [\n";
+        for (int i = 0; i < mResults.size(); i++) {
+            const Result &r = mResults.at(i);
+            double msecs = double(r.msecs) / r.iterations;
+            double throughput = msecs > 0 ? r.size / (msecs / 1000.0) / (1024 * 1024) : 0;
+            csvOut << r.operation << "," << r.size << "," << r.recipients << "," << r.keyringSize << ","
+                   << r.iterations << "," << QString::number(msecs, 'f', 3) << ","
+                   << QString::number(throughput, 'f', 2) << "," << r.heapAllocations << ","
+                   << r.heapBytes << "," << r.copiedBytes << "\n";
+            jsonOut << "    {\"operation\": \"" << r.operation << "\", \"payload_bytes\": " << r.size
+                    << ", \"recipients\": " << r.recipients << ", \"keyring_keys\": " << r.keyringSize
+                    << ", \"iterations\": " << r.iterations << ", \"msecs\": " << QString::number(msecs, 'f', 3)
+                    << ", \"mb_per_s\": " << QString::number(throughput, 'f', 2)
+                    << ", \"heap_allocations\": " << r.heapAllocations << ", \"heap_bytes\": " << r.heapBytes
+                    << ", \"copied_bytes\": " << r.copiedBytes << "}"
+                    << (i + 1 < mResults.size() ? ",\n" : "\n");
+        }
+        jsonOut << "  ]\n}\n";
+        qDebug() << "results written to" << csv.fileName() << "and" << json.fileName();
+}
+
+/**
+* payload sizes from 1 kB to 1 GB, up to limit and GPG4USB_BENCH_MAX_SIZE
+*/
+void BenchmarkGpgContext::addSizeRows(qint64 limit) {
+        static const qint64 sizes[] = { Q_INT64_C(1024), Q_INT64_C(64) * 1024, Q_INT64_C(1024) * 1024,
+                                        Q_INT64_C(16) * 1024 * 1024, Q_INT64_C(64) * 1024 * 1024,
+                                        Q_INT64_C(1024) * 1024 * 1024 };
+        QTest::addColumn<qint64>("size");
+        for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            if (sizes[i] <= qMin(limit, mMaxSize)) {
+                QTest::newRow(qPrintable(QString("%1 kB").arg(sizes[i] / 1024))) << sizes[i];
+            }
+        }
+}
+
+void BenchmarkGpgContext::encrypt_data() {
+        QTest::addColumn<qint64>("size");
+        QTest::addColumn<int>("recipients");
+        static const qint64 sizes[] = { Q_INT64_C(1024), Q_INT64_C(1024) * 1024, Q_INT64_C(64) * 1024 * 1024 };
+        for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            for (unsigned j = 0; j < sizeof(recipientCounts) / sizeof(recipientCounts[0]); j++) {
+                if (sizes[i] <= mMaxSize) {
+                    QTest::newRow(qPrintable(QString("%1 kB, %2 recipients").arg(sizes[i] / 1024).arg(recipientCounts[j])))
+                            << sizes[i] << recipientCounts[j];
+                }
+            }
+        }
+}
+
+void BenchmarkGpgContext::encrypt() {
+        QFETCH(qint64, size);
+        QFETCH(int, recipients);
+
+        QByteArray plain = payload(size);
+        QStringList uidList = this->recipients(recipients);
+        QByteArray cipher;
+        int iterations = 0;
+        QTime time;
+        time.start();
+        QBENCHMARK {
+            QVERIFY(mCtx->encrypt(&uidList, plain, &cipher, false));
+            iterations++;
+        }
+        record("encrypt", size, recipients, time.elapsed(), iterations);
+}
+
+void BenchmarkGpgContext::decrypt_data() {
+        addSizeRows(bufferLimit);
+}
+
+void BenchmarkGpgContext::decrypt() {
+        QFETCH(qint64, size);
+
+        QStringList uidList = recipients(1);
+        QByteArray cipher, plain;
+        QVERIFY(mCtx->encrypt(&uidList, payload(size), &cipher, false));
+        PassphraseAnswer answer;
+
+        int iterations = 0;
+        QTime time;
+        time.start();
+        QBENCHMARK {
+            QVERIFY(mCtx->decrypt(cipher, &plain));
+            iterations++;
+        }
+        record("decrypt", size, 1, time.elapsed(), iterations);
+        QCOMPARE(plain.size(), int(size));
+}
+
+void BenchmarkGpgContext::sign_data() {
+        addSizeRows(Q_INT64_C(16) * 1024 * 1024);
+}
+
+void BenchmarkGpgContext::sign() {
+        QFETCH(qint64, size);
+
+        QStringList uidList = recipients(1);
+        QByteArray text = textPayload(size);
+        QByteArray signedText;
+        PassphraseAnswer answer;
+
+        int iterations = 0;
+        QTime time;
+        time.start();
+        QBENCHMARK {
+            QVERIFY(mCtx->sign(&uidList, text, &signedText));
+            iterations++;
+        }
+        record("sign", size, 1, time.elapsed(), iterations);
+}
+
+void BenchmarkGpgContext::verify_data() {
+        addSizeRows(Q_INT64_C(16) * 1024 * 1024);
+}
+
+void BenchmarkGpgContext::verify() {
+        QFETCH(qint64, size);
+
+        QStringList uidList = recipients(1);
+        QByteArray signedText;
+        PassphraseAnswer answer;
+        QVERIFY(mCtx->sign(&uidList, textPayload(size), &signedText));
+
+        int iterations = 0;
+        QTime time;
+        time.start();
+        QBENCHMARK {
+            QVERIFY(mCtx->verify(signedText) != 0);
+            iterations++;
+        }
+        record("verify", size, 1, time.elapsed(), iterations);
+}
+
+void BenchmarkGpgContext::encryptFile_data() {
+        addSizeRows(Q_INT64_C(1024) * 1024 * 1024);
+}
+
+void BenchmarkGpgContext::encryptFile() {
+        QFETCH(qint64, size);
+
+        writePayloadFile("benchmark.bin", size);
+        QStringList uidList = recipients(1);
+        QFile in("benchmark.bin");
+        QFile out("benchmark.bin.gpg");
+
+        int iterations = 0;
+        QTime time;
+        time.start();
+        QBENCHMARK {
+            QVERIFY(in.open(QIODevice::ReadOnly));
+            QVERIFY(out.open(QIODevice::WriteOnly | QIODevice::Truncate));
+            QVERIFY(mCtx->encryptFile(&uidList, &in, &out));
+            in.close();
+            out.close();
+            iterations++;
+        }
+        record("encryptFile", size, 1, time.elapsed(), iterations);
+        in.remove();
+        out.remove();
+}
+
+void BenchmarkGpgContext::decryptFile_data() {
+        addSizeRows(Q_INT64_C(1024) * 1024 * 1024);
+}
+
+void BenchmarkGpgContext::decryptFile() {
+        QFETCH(qint64, size);
+
+        writePayloadFile("benchmark.bin", size);
+        QStringList uidList = recipients(1);
+        QFile plain("benchmark.bin");
+        QFile cipher("benchmark.bin.gpg");
+        QVERIFY(plain.open(QIODevice::ReadOnly));
+        QVERIFY(cipher.open(QIODevice::WriteOnly | QIODevice::Truncate));
+        QVERIFY(mCtx->encryptFile(&uidList, &plain, &cipher));
+        plain.close();
+        cipher.close();
+        PassphraseAnswer answer;
+
+        int iterations = 0;
+        QTime time;
+        time.start();
+        QBENCHMARK {
+            QVERIFY(cipher.open(QIODevice::ReadOnly));
+            QVERIFY(plain.open(QIODevice::WriteOnly | QIODevice::Truncate));
+            QVERIFY(mCtx->decryptFile(&cipher, &plain));
+            cipher.close();
+            plain.close();
+            iterations++;
+        }
+        record("decryptFile", size, 1, time.elapsed(), iterations);
+        QCOMPARE(plain.size(), size);
+        plain.remove();
+        cipher.remove();
+}
+
+void BenchmarkGpgContext::importKey_data() {
+        QTest::addColumn<int>("keys");
+        for (unsigned j = 0; j < sizeof(recipientCounts) / sizeof(recipientCounts[0]); j++) {
+            QTest::newRow(qPrintable(QString("%1 keys").arg(recipientCounts[j]))) << recipientCounts[j];
+        }
+}
+
+/**
+* import of keys already in the keyring, as done when a keyring is
+* imported again
+*/
+void BenchmarkGpgContext::importKey() {
+        QFETCH(int, keys);
+
+        QStringList uidList = recipients(keys);
+        QByteArray exported;
+        QVERIFY(mCtx->exportKeys(&uidList, &exported));
+
+        int iterations = 0;
+        QTime time;
+        time.start();
+        QBENCHMARK {
+            GpgImportInformation result = mCtx->importKey(exported);
+            QCOMPARE(result.considered, keys);
+            iterations++;
+        }
+        record("importKey", exported.size(), keys, time.elapsed(), iterations);
+}
+
+/**
+* import of the whole generated keyring, all keys are known and unchanged
+*/
+void BenchmarkGpgContext::importKeyring() {
+        if (mKeyringFile.isEmpty()) {
+            QSKIP("set GPG4USB_BENCH_KEYS to import a generated keyring", SkipAll);
+        }
+        QFile keyringFile(mKeyringFile);
+
+        int iterations = 0;
+        QTime time;
+        time.start();
+        QBENCHMARK_ONCE {
+            QVERIFY(keyringFile.open(QIODevice::ReadOnly));
+            GpgImportInformation result = mCtx->importKeyFile(&keyringFile);
+            QCOMPARE(result.considered, mGeneratedKeys);
+            keyringFile.close();
+            iterations++;
+        }
+        record("importKeyring", keyringFile.size(), 0, time.elapsed(), iterations);
+}
+
+void BenchmarkGpgContext::importOverlap_data() {
+        QTest::addColumn<bool>("skipUnchanged");
+        QTest::newRow("all keys to gpg") << false;
+        QTest::newRow("skip unchanged") << true;
+}
+
+/**
+* re-import of a keyring, of which 95% of the keys are known, into its
+* own keydb. GPG4USB_BENCH_KEYS keys are generated, at least 1000
+*/
+void BenchmarkGpgContext::importOverlap() {
+        QFETCH(bool, skipUnchanged);
+        const int keys = qMax(1000, mGeneratedKeys);
+        QString keyDir = mKeyDir + "-overlap";
+        QVERIFY(QDir().mkpath(keyDir));
+
+        KeyringGenerator generator;
+        generator.setKeyCount(keys);
+        QByteArray keyring;
+        QBuffer buffer(&keyring);
+        buffer.open(QIODevice::WriteOnly);
+        QVERIFY(generator.write(&buffer));
+        buffer.close();
+
+        buffer.open(QIODevice::ReadOnly);
+        PgpKeyReader reader(&buffer);
+        QByteArray key, known;
+        for (int i = 0; i < keys * 95 / 100 && reader.readKey(&key); i++) {
+            known.append(key);
+        }
+        buffer.close();
+
+        {
+            GpgME::GpgContext ctx(keyDir);
+            QBuffer knownBuffer(&known);
+            knownBuffer.open(QIODevice::ReadOnly);
+            ctx.importKeyFile(&knownBuffer, true);
+
+            int iterations = 0;
+            QTime time;
+            time.start();
+            QBENCHMARK_ONCE {
+                QVERIFY(buffer.open(QIODevice::ReadOnly));
+                GpgImportInformation result = ctx.importKeyFile(&buffer, skipUnchanged);
+                QCOMPARE(result.considered, keys);
+                buffer.close();
+                iterations++;
+            }
+            record(skipUnchanged ? "importOverlapSkipUnchanged" : "importOverlap", keyring.size(), 0,
+                   time.elapsed(), iterations);
+        }
+        removeDir(keyDir);
+}
+
+/**
+* a full listing of the keyring, public and secret keys
+*/
+void BenchmarkGpgContext::listKeys() {
+        int iterations = 0;
+        QTime time;
+        time.start();
+        QBENCHMARK {
+            QCOMPARE(mCtx->listKeys().size(), mKeyringSize);
+            iterations++;
+        }
+        record("listKeys", 0, 0, time.elapsed(), iterations);
+}
+
+/**
+* filling the key list of the main window and the key management
+*/
+void BenchmarkGpgContext::keyListModel() {
+        int iterations = 0;
+        QTime time;
+        time.start();
+        QBENCHMARK {
+            KeyListModel model;
+            model.setSnapshot(mCtx->keySnapshot());
+            QCOMPARE(model.rowCount(), mKeyringSize);
+            iterations++;
+        }
+        record("keyListModel", 0, 0, time.elapsed(), iterations);
+}
+
+void BenchmarkGpgContext::restart_data() {
+        QTest::addColumn<bool>("keepContext");
+        QTest::newRow("context kept") << true;
+        QTest::newRow("context rebuilt") << false;
+}
+
+/**
+* what a language change rebuilds besides the widgets: the key list of
+* the main window, and without a kept context gpgme and the keyring
+* listing
+*/
+void BenchmarkGpgContext::restart() {
+        QFETCH(bool, keepContext);
+
+        int iterations = 0;
+        QTime time;
+        time.start();
+        QBENCHMARK {
+            GpgME::GpgContext *ctx = keepContext ? mCtx : new GpgME::GpgContext(mKeyDir);
+            KeyList *keyList = new KeyList(ctx);
+            QCOMPARE(ctx->keySnapshot()->size(), mKeyringSize);
+            delete keyList;
+            if (!keepContext) {
+                delete ctx;
+            }
+            iterations++;
+        }
+        record(keepContext ? "restartContextKept" : "restartContextRebuilt", 0, 0, time.elapsed(), iterations);
+}
+
+void BenchmarkGpgContext::exportKeys_data() {
+        QTest::addColumn<int>("keys");
+        QTest::newRow("1 keys") << 1;
+        QTest::newRow("100 keys") << 100;
+        QTest::newRow("10000 keys") << 10000;
+}
+
+/**
+* export of the first keys of the keyring with one gpg run per 500
+* keys, the row records the size of the export. Rows with more keys
+* than the keyring are skipped, GPG4USB_BENCH_KEYS fills it
+*/
+void BenchmarkGpgContext::exportKeys() {
+        QFETCH(int, keys);
+
+        QSharedPointer<const GpgKeyStore> snapshot = mCtx->keySnapshot();
+        if (snapshot->size() < keys) {
+            QSKIP("the keyring has fewer keys, set GPG4USB_BENCH_KEYS", SkipSingle);
+        }
+        QStringList uidList;
+        for (int i = 0; i < keys; i++) {
+            uidList << snapshot->at(i).id;
+        }
+
+        QByteArray out;
+        int iterations = 0;
+        QTime time;
+        time.start();
+        QBENCHMARK {
+            QVERIFY(mCtx->exportKeys(&uidList, &out));
+            iterations++;
+        }
+        record("exportKeys", out.size(), keys, time.elapsed(), iterations);
+}
+
+/**
+* building the search index of a keyring with 100k keys
+*/
+void BenchmarkGpgContext::keySearchBuild() {
+        GpgKeyStore store = syntheticStore(100000);
+        int iterations = 0;
+        QTime time;
+        time.start();
+        QBENCHMARK {
+            KeySearchIndex index(store);
+            iterations++;
+        }
+        record("keySearchBuild", 0, 0, time.elapsed(), iterations);
+}
+
+void BenchmarkGpgContext::keySearchQuery_data() {
+        QTest::addColumn<QString>("text");
+        QTest::addColumn<int>("matches");
+        QTest::newRow("single letter") << "a" << 12500;
+        QTest::newRow("name") << "car" << 12500;
+        QTest::newRow("two words") << "carol tester12346" << 1;
+        QTest::newRow("email") << "eve.4@example4" << 1;
+        QTest::newRow("key id") << "deadbeef0001869f" << 1;
+}
+
+/**
+* latency of one keystroke in a keyring with 100k keys
+*/
+void BenchmarkGpgContext::keySearchQuery() {
+        QFETCH(QString, text);
+        QFETCH(int, matches);
+        static GpgKeyStore store = syntheticStore(100000);
+        static KeySearchIndex index(store);
+
+        QBitArray result;
+        int iterations = 0;
+        QTime time;
+        time.start();
+        QBENCHMARK {
+            result = index.search(text);
+            iterations++;
+        }
+        record("keySearchQuery " + text, 0, 0, time.elapsed(), iterations);
+        QCOMPARE(result.count(true), matches);
+}
+
+void BenchmarkGpgContext::encryptRecipients_data() {
+        QTest::addColumn<int>("recipients");
+        QTest::newRow("1 recipients") << 1;
+        QTest::newRow("10 recipients") << 10;
+        QTest::newRow("50 recipients") << 50;
+        QTest::newRow("200 recipients") << 200;
+}
+
+/**
+* per message latency for a growing number of recipients. The test key
+* is given repeatedly, so only the key lookups grow, not the keyring
+*/
+void BenchmarkGpgContext::encryptRecipients() {
+        QFETCH(int, recipients);
+
+        QStringList uidList;
+        for (int i = 0; i < recipients; i++) {
+            uidList << testKeyId;
+        }
+
+        QByteArray out;
+        int iterations = 0;
+        QTime time;
+        time.start();
+        QBENCHMARK {
+            QVERIFY(mCtx->encrypt(&uidList, QByteArray("a secret"), &out));
+            iterations++;
+        }
+        record("encryptRecipients", 8, recipients, time.elapsed(), iterations);
+}
+
+/**
+* 64 files of 256 kB encrypted on all cores, the row records the bytes
+* read and the time from the first start to the last finished file
+*/
+void BenchmarkGpgContext::encryptBatch() {
+        const int files = 64;
+        const int size = 256 * 1024;
+
+        QString dirName = mKeyDir + "-batch";
+        QVERIFY(QDir().mkpath(dirName));
+        QByteArray plain = payload(size);
+        GpgME::GpgBatch batch(mCtx, GpgME::GpgJob::EncryptFile);
+        batch.setKeys(recipients(1));
+        for (int i = 0; i < files; i++) {
+            QFile file(QString("%1/%2.bin").arg(dirName).arg(i));
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write(plain);
+            file.close();
+            batch.addFile(file.fileName(), file.fileName() + ".gpg");
+        }
+
+        QEventLoop loop;
+        connect(&batch, SIGNAL(signalFinished()), &loop, SLOT(quit()));
+        batch.start();
+        loop.exec();
+
+        record(QString("encryptBatch %1 threads").arg(QThread::idealThreadCount()), batch.bytesProcessed(), 1,
+               batch.elapsed(), 1);
+        QCOMPARE(batch.failedCount(), 0);
+        removeDir(dirName);
+}
+
+void BenchmarkGpgContext::encryptMultiFile_data() {
+        QTest::addColumn<int>("files");
+        QTest::addColumn<bool>("multiFile");
+        foreach (int files, QList<int>() << 10 << 100 << 1000) {
+            QTest::newRow(qPrintable(QString("%1 files gpgme").arg(files))) << files << false;
+            QTest::newRow(qPrintable(QString("%1 files multifile").arg(files))) << files << true;
+        }
+}
+
+/**
+* small files encrypted with one gpgme call per file against one
+* gpg --multifile run per 200 files
+*/
+void BenchmarkGpgContext::encryptMultiFile() {
+        QFETCH(int, files);
+        QFETCH(bool, multiFile);
+
+        QString dirName = mKeyDir + "-multifile";
+        QVERIFY(QDir().mkpath(dirName));
+        QStringList fileNames;
+        for (int i = 0; i < files; i++) {
+            QFile file(QString("%1/%2.txt").arg(dirName).arg(i));
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write(QByteArray(1024, 'a' + i % 26));
+            file.close();
+            fileNames << file.fileName();
+        }
+
+        QStringList uidList = recipients(1);
+        int iterations = 0;
+        QTime time;
+        time.start();
+        QBENCHMARK_ONCE {
+            if (multiFile) {
+                GpgFileResultList results = mCtx->multiFile(GpgME::GpgContext::EncryptFiles, fileNames, &uidList);
+                QCOMPARE(results.size(), files);
+            } else {
+                foreach (QString fileName, fileNames) {
+                    QFile in(fileName);
+                    QFile out(fileName + ".gpg");
+                    QVERIFY(in.open(QIODevice::ReadOnly));
+                    QVERIFY(out.open(QIODevice::WriteOnly));
+                    QVERIFY(mCtx->encryptFile(&uidList, &in, &out));
+                }
+            }
+            iterations++;
+        }
+        record(multiFile ? "encryptMultiFile" : "encryptFiles", Q_INT64_C(1024) * files, 1, time.elapsed(), iterations);
+        removeDir(dirName);
+}
+
+void BenchmarkGpgContext::encryptFileArmor_data() {
+        QTest::addColumn<bool>("armor");
+        QTest::newRow("binary") << false;
+        QTest::newRow("armor") << true;
+}
+
+/**
+* binary and armored encryption of 8 MB, the row records the size of
+* the output, armor adds a third
+*/
+void BenchmarkGpgContext::encryptFileArmor() {
+        QFETCH(bool, armor);
+        const int size = 8 * 1024 * 1024;
+
+        QByteArray plain = payload(size);
+        QStringList uidList = recipients(1);
+        QByteArray cipher;
+        int iterations = 0;
+        QTime time;
+        time.start();
+        QBENCHMARK {
+            QBuffer in(&plain);
+            in.open(QIODevice::ReadOnly);
+            cipher.clear();
+            QBuffer out(&cipher);
+            out.open(QIODevice::WriteOnly);
+            QVERIFY(mCtx->encryptFile(&uidList, &in, &out, armor));
+            iterations++;
+        }
+        record(armor ? "encryptFileArmor" : "encryptFileBinary", cipher.size(), 1, time.elapsed(), iterations);
+}
+
+void BenchmarkGpgContext::encryptSign_data() {
+        QTest::addColumn<bool>("singlePass");
+        QTest::newRow("sign then encrypt") << false;
+        QTest::newRow("encryptSign") << true;
+}
+
+/**
+* signing and encrypting a message in one gpg run against clearsigning
+* and encrypting the signed text, as done by running sign and encrypt
+* from the toolbar one after the other
+*/
+void BenchmarkGpgContext::encryptSign() {
+        QFETCH(bool, singlePass);
+
+        QStringList uidList = recipients(1);
+        QByteArray plain = textPayload(16 * 1024);
+        QByteArray signedText, cipher;
+        PassphraseAnswer answer;
+        // the password is cached by the first run
+        QVERIFY(mCtx->sign(&uidList, plain, &signedText));
+
+        int iterations = 0;
+        QTime time;
+        time.start();
+        QBENCHMARK {
+            if (singlePass) {
+                QVERIFY(mCtx->encryptSign(&uidList, &uidList, plain, &cipher));
+            } else {
+                QVERIFY(mCtx->sign(&uidList, plain, &signedText));
+                QVERIFY(mCtx->encrypt(&uidList, signedText, &cipher));
+            }
+            iterations++;
+        }
+        record(singlePass ? "encryptSign" : "signThenEncrypt", plain.size(), 1, time.elapsed(), iterations);
+}
+
+void BenchmarkGpgContext::bufferCopies_data() {
+        addSizeRows(Q_INT64_C(64) * 1024 * 1024);
+}
+
+/**
+* heap allocations, bytes allocated and bytes copied by realloc while
+* encrypting and decrypting a buffer. The input is read in place and
+* the output written into one reserved buffer, so each must stay well
+* below twice the payload
+*/
+void BenchmarkGpgContext::bufferCopies() {
+#if !defined(Q_OS_LINUX) || !defined(__GLIBC__)
+        QSKIP("allocations are counted by wrapping the glibc allocator", SkipAll);
+#else
+        QFETCH(qint64, size);
+
+        QByteArray plain = payload(size);
+        QStringList uidList = recipients(1);
+        QByteArray cipher, decrypted;
+        PassphraseAnswer answer;
+        // the password is cached by the first run, the dialog isn't counted
+        QVERIFY(mCtx->encrypt(&uidList, payload(1024), &cipher, false));
+        QVERIFY(mCtx->decrypt(cipher, &decrypted));
+
+        QTime time;
+        time.start();
+        startHeapCount();
+        QVERIFY(mCtx->encrypt(&uidList, plain, &cipher, false));
+        stopHeapCount();
+        record("bufferCopiesEncrypt", size, 1, time.elapsed(), 1, sHeapAllocations, sHeapBytes, sHeapCopied);
+        QVERIFY(sHeapBytes < 2 * size);
+        QVERIFY(sHeapCopied < size / 4);
+
+        time.start();
+        startHeapCount();
+        QVERIFY(mCtx->decrypt(cipher, &decrypted));
+        stopHeapCount();
+        record("bufferCopiesDecrypt", size, 1, time.elapsed(), 1, sHeapAllocations, sHeapBytes, sHeapCopied);
+        QVERIFY(sHeapBytes < 2 * size);
+        QVERIFY(sHeapCopied < size / 4);
+        QVERIFY(decrypted == plain);
+#endif
+}
+
+QTEST_MAIN(BenchmarkGpgContext)
+#include "benchmarkgpgcontext.moc"
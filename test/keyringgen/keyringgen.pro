@@ -0,0 +1,16 @@
+######################################################################
+# writes large synthetic keyrings for scale tests, see ./keyringgen -h
+######################################################################
+
+TEMPLATE = app
+TARGET = keyringgen
+QT -= gui
+CONFIG += console
+DEPENDPATH += .
+INCLUDEPATH += . ..
+DESTDIR = ..
+
+# Input
+SOURCES += main.cpp \
+           ../keyringgenerator.cpp
+HEADERS += ../keyringgenerator.h
@@ -0,0 +1,113 @@
+/*
+ *      main.cpp
+ *
+ *      Copyright 2008 gpg4usb-team <gpg4usb@cpunk.de>
+ *
+ *      This file is part of gpg4usb.
+ *
+ *      Gpg4usb is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      Gpg4usb is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with gpg4usb.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QStringList>
+#include <QTextStream>
+#include "keyringgenerator.h"
+
+/**
+* keyringgen -n 10000 -u 3 -e 10 -r 5 -k keydb
+* keyringgen -n 100000 -o keyring.gpg
+*/
+static void usage(QTextStream &err) {
+        err << "usage: keyringgen [-n keys] [-u maxuids] [-e expired%] [-r revoked%] [-s seed]\n"
+            << "                  (-o keyring | -k keydbdir)\n"
+            << "  -n  number of keys, default 1000\n"
+            << "  -u  up to this many user ids per key, default 3\n"
+            << "  -e  percent of expired keys, default 0\n"
+            << "  -r  percent of revoked keys, default 0\n"
+            << "  -s  seed, the same seed gives the same keyring\n"
+            << "  -o  write a binary keyring file, - for stdout\n"
+            << "  -k  write pubring.gpg of a keydb directory\n";
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream err(stderr);
+    QStringList args = app.arguments();
+
+    KeyringGenerator generator;
+    QString outFile;
+    QString keyDir;
+    for (int i = 1; i < args.size(); i++) {
+        QString option = args.at(i);
+        if (option == "-h" || option == "--help") {
+            usage(err);
+            return 0;
+        }
+        if (i + 1 >= args.size()) {
+            usage(err);
+            return 1;
+        }
+        QString value = args.at(++i);
+        bool ok = true;
+        if (option == "-n") {
+            generator.setKeyCount(value.toInt(&ok));
+        } else if (option == "-u") {
+            generator.setMaxUids(value.toInt(&ok));
+        } else if (option == "-e") {
+            generator.setExpiredPercent(value.toInt(&ok));
+        } else if (option == "-r") {
+            generator.setRevokedPercent(value.toInt(&ok));
+        } else if (option == "-s") {
+            generator.setSeed(value.toUInt(&ok));
+        } else if (option == "-o") {
+            outFile = value;
+        } else if (option == "-k") {
+            keyDir = value;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            err << "invalid option " << option << " " << value << "\n";
+            usage(err);
+            return 1;
+        }
+    }
+    if (outFile.isEmpty() == keyDir.isEmpty()) {
+        usage(err);
+        return 1;
+    }
+
+    bool written;
+    if (!keyDir.isEmpty()) {
+        written = generator.writeKeyDB(keyDir);
+    } else {
+        QFile out;
+        if (outFile == "-") {
+            written = out.open(stdout, QIODevice::WriteOnly);
+        } else {
+            out.setFileName(outFile);
+            written = out.open(QIODevice::WriteOnly | QIODevice::Truncate);
+        }
+        written = written && generator.write(&out);
+    }
+    if (!written) {
+        err << "can't write " << (keyDir.isEmpty() ? outFile : keyDir) << "\n";
+        return 1;
+    }
+    err << "written, " << generator.expiredCount() << " expired and "
+        << generator.revokedCount() << " revoked keys\n";
+    return 0;
+}
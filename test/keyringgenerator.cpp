@@ -0,0 +1,454 @@
+/*
+ *      keyringgenerator.cpp
+ *
+ *      Copyright 2008 gpg4usb-team <gpg4usb@cpunk.de>
+ *
+ *      This file is part of gpg4usb.
+ *
+ *      Gpg4usb is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      Gpg4usb is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with gpg4usb.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "keyringgenerator.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QStringList>
+
+namespace {
+
+/** 512 bit RSA key of all generated keys, small to keep signing cheap */
+const char *modulusHex = "e0ef37513a6851fcb8a20d6f764786255cce3539c4b4b2fe88ad64b2aa89872f"
+                         "133d3d3b1c0ef7dbcc4613eb168dfb9899459267e3d4e423b2c3b51c225fbd25";
+const char *privateExponentHex = "45bde608e9732ef88cc6b223bd28b00f25974a297f3407cba3d51f43c65c9ded"
+                                 "059ca1ed3842d05060adbc6bdc310c81ae8325c6979c78d31aa746dba8bab001";
+const quint32 publicExponent = 65537;
+
+/** creation time of the first key, 2005-01-01, every further key a minute later */
+const quint32 firstCreationTime = 1104537600;
+const quint32 expirationTime = 365 * 24 * 3600;
+
+const char *firstNames[] = { "Alice", "Bob", "Carol", "Dave", "Eve", "Frank", "Grace", "Heidi",
+                             "Ivan", "Judy", "Mallory", "Oscar", "Peggy", "Trent", "Victor", "Walter" };
+const char *lastNames[] = { "Smith", "Miller", "Schmidt", "Dubois", "Rossi", "Novak", "Tanaka",
+                            "Silva", "Kowalski", "Jensen", "Garcia", "Nguyen" };
+
+// numbers of the RSA key in 32 bit limbs, least significant first
+
+const int Limbs = 16;
+
+void fromBigEndian(quint32 *x, const unsigned char *bytes, int size)
+{
+    for (int i = 0; i < Limbs; i++) {
+        x[i] = 0;
+    }
+    for (int i = 0; i < size; i++) {
+        int bit = (size - 1 - i) * 8;
+        x[bit / 32] |= (quint32)bytes[i] << (bit % 32);
+    }
+}
+
+void toBigEndian(unsigned char *bytes, const quint32 *x)
+{
+    for (int i = 0; i < Limbs * 4; i++) {
+        int bit = (Limbs * 4 - 1 - i) * 8;
+        bytes[i] = (unsigned char)(x[bit / 32] >> (bit % 32));
+    }
+}
+
+bool greaterOrEqual(const quint32 *x, const quint32 *m)
+{
+    for (int i = Limbs - 1; i >= 0; i--) {
+        if (x[i] != m[i]) {
+            return x[i] > m[i];
+        }
+    }
+    return true;
+}
+
+void subtract(quint32 *x, const quint32 *m)
+{
+    quint64 borrow = 0;
+    for (int i = 0; i < Limbs; i++) {
+        quint64 d = (quint64)x[i] - m[i] - borrow;
+        x[i] = (quint32)d;
+        borrow = (d >> 32) & 1;
+    }
+}
+
+/** Montgomery product r = a * b / 2^(32 * Limbs) mod m,
+ *  mInv is -1 / m mod 2^32
+ */
+void montgomeryMultiply(quint32 *r, const quint32 *a, const quint32 *b, const quint32 *m, quint32 mInv)
+{
+    quint32 t[Limbs + 2];
+    for (int i = 0; i < Limbs + 2; i++) {
+        t[i] = 0;
+    }
+    for (int i = 0; i < Limbs; i++) {
+        quint64 c = 0;
+        for (int j = 0; j < Limbs; j++) {
+            c += (quint64)a[j] * b[i] + t[j];
+            t[j] = (quint32)c;
+            c >>= 32;
+        }
+        c += t[Limbs];
+        t[Limbs] = (quint32)c;
+        t[Limbs + 1] = (quint32)(c >> 32);
+
+        quint32 u = t[0] * mInv;
+        c = ((quint64)u * m[0] + t[0]) >> 32;
+        for (int j = 1; j < Limbs; j++) {
+            c += (quint64)u * m[j] + t[j];
+            t[j - 1] = (quint32)c;
+            c >>= 32;
+        }
+        c += t[Limbs];
+        t[Limbs - 1] = (quint32)c;
+        t[Limbs] = t[Limbs + 1] + (quint32)(c >> 32);
+    }
+    if (t[Limbs] || greaterOrEqual(t, m)) {
+        subtract(t, m);
+    }
+    for (int i = 0; i < Limbs; i++) {
+        r[i] = t[i];
+    }
+}
+
+/** r = base ^ exponent mod m, base < m
+ */
+void powerMod(quint32 *r, const quint32 *base, const quint32 *exponent, const quint32 *m)
+{
+    quint32 inv = 1;
+    for (int i = 0; i < 5; i++) {
+        inv *= 2 - m[0] * inv;
+    }
+    quint32 mInv = 0 - inv;
+
+    // 2^(64 * Limbs) mod m, converts into the Montgomery form
+    quint32 rSquare[Limbs];
+    for (int i = 0; i < Limbs; i++) {
+        rSquare[i] = 0;
+    }
+    rSquare[0] = 1;
+    for (int i = 0; i < 64 * Limbs; i++) {
+        quint32 carry = rSquare[Limbs - 1] >> 31;
+        for (int j = Limbs - 1; j > 0; j--) {
+            rSquare[j] = (rSquare[j] << 1) | (rSquare[j - 1] >> 31);
+        }
+        rSquare[0] <<= 1;
+        if (carry || greaterOrEqual(rSquare, m)) {
+            subtract(rSquare, m);
+        }
+    }
+
+    quint32 one[Limbs];
+    for (int i = 0; i < Limbs; i++) {
+        one[i] = 0;
+    }
+    one[0] = 1;
+
+    quint32 x[Limbs], acc[Limbs];
+    montgomeryMultiply(x, base, rSquare, m, mInv);
+    montgomeryMultiply(acc, one, rSquare, m, mInv);
+    for (int bit = 32 * Limbs - 1; bit >= 0; bit--) {
+        montgomeryMultiply(acc, acc, acc, m, mInv);
+        if ((exponent[bit / 32] >> (bit % 32)) & 1) {
+            montgomeryMultiply(acc, acc, x, m, mInv);
+        }
+    }
+    montgomeryMultiply(r, acc, one, m, mInv);
+}
+
+// OpenPGP packets, RFC 4880
+
+void appendUInt16(QByteArray *data, quint32 value)
+{
+    data->append((char)(value >> 8));
+    data->append((char)value);
+}
+
+void appendUInt32(QByteArray *data, quint32 value)
+{
+    appendUInt16(data, value >> 16);
+    appendUInt16(data, value & 0xffff);
+}
+
+void appendMpi(QByteArray *data, const QByteArray &bigEndian)
+{
+    int start = 0;
+    while (start < bigEndian.size() && bigEndian.at(start) == 0) {
+        start++;
+    }
+    int bits = (bigEndian.size() - start) * 8;
+    if (bits > 0) {
+        unsigned char top = (unsigned char)bigEndian.at(start);
+        for (int bit = 7; bit >= 0 && !((top >> bit) & 1); bit--) {
+            bits--;
+        }
+    }
+    appendUInt16(data, bits);
+    data->append(bigEndian.mid(start));
+}
+
+/** old format header, length type by body size */
+QByteArray packet(int tag, const QByteArray &body)
+{
+    QByteArray data;
+    if (body.size() < 256) {
+        data.append((char)(0x80 | tag << 2));
+        data.append((char)body.size());
+    } else if (body.size() < 65536) {
+        data.append((char)(0x80 | tag << 2 | 1));
+        appendUInt16(&data, body.size());
+    } else {
+        data.append((char)(0x80 | tag << 2 | 2));
+        appendUInt32(&data, body.size());
+    }
+    return data + body;
+}
+
+QByteArray subpacket(int type, const QByteArray &data)
+{
+    QByteArray sub;
+    sub.append((char)(data.size() + 1));
+    sub.append((char)type);
+    return sub + data;
+}
+
+QByteArray uint32Bytes(quint32 value)
+{
+    QByteArray data;
+    appendUInt32(&data, value);
+    return data;
+}
+
+class RsaKey
+{
+public:
+    RsaKey() {
+        QByteArray n = QByteArray::fromHex(modulusHex);
+        QByteArray d = QByteArray::fromHex(privateExponentHex);
+        fromBigEndian(mModulus, (const unsigned char *)n.constData(), n.size());
+        fromBigEndian(mExponent, (const unsigned char *)d.constData(), d.size());
+        mModulusBytes = n;
+    }
+
+    QByteArray modulus() const {
+        return mModulusBytes;
+    }
+
+    /** EMSA-PKCS1-v1_5 signature of a SHA-1 hash */
+    QByteArray sign(const QByteArray &hash) const {
+        static const char digestInfo[] = "\x30\x21\x30\x09\x06\x05\x2b\x0e\x03\x02\x1a\x05\x00\x04\x14";
+        QByteArray encoded;
+        encoded.append('\0');
+        encoded.append('\1');
+        encoded.append(QByteArray(Limbs * 4 - 3 - 15 - hash.size(), '\xff'));
+        encoded.append('\0');
+        encoded.append(QByteArray(digestInfo, 15));
+        encoded.append(hash);
+
+        quint32 m[Limbs], s[Limbs];
+        fromBigEndian(m, (const unsigned char *)encoded.constData(), encoded.size());
+        powerMod(s, m, mExponent, mModulus);
+        QByteArray signature(Limbs * 4, 0);
+        toBigEndian((unsigned char *)signature.data(), s);
+        return signature;
+    }
+
+private:
+    quint32 mModulus[Limbs];
+    quint32 mExponent[Limbs];
+    QByteArray mModulusBytes;
+};
+
+/** v4 signature with SHA-1, signedData is hashed before the
+ *  signature fields
+ */
+QByteArray signature(const RsaKey &rsa, const QByteArray &keyId, int type,
+                     const QByteArray &hashedSubpackets, const QByteArray &signedData)
+{
+    QByteArray hashed;
+    hashed.append((char)4);
+    hashed.append((char)type);
+    hashed.append((char)1); // RSA
+    hashed.append((char)2); // SHA-1
+    appendUInt16(&hashed, hashedSubpackets.size());
+    hashed.append(hashedSubpackets);
+
+    QByteArray trailer;
+    trailer.append((char)4);
+    trailer.append((char)0xff);
+    appendUInt32(&trailer, hashed.size());
+    QByteArray hash = QCryptographicHash::hash(signedData + hashed + trailer, QCryptographicHash::Sha1);
+
+    QByteArray unhashed = subpacket(16, keyId);
+    QByteArray body = hashed;
+    appendUInt16(&body, unhashed.size());
+    body.append(unhashed);
+    body.append(hash.left(2));
+    appendMpi(&body, rsa.sign(hash));
+    return packet(2, body);
+}
+
+} // namespace
+
+KeyringGenerator::KeyringGenerator()
+{
+    mKeyCount = 1000;
+    mMaxUids = 3;
+    mExpiredPercent = 0;
+    mRevokedPercent = 0;
+    mSeed = 1;
+    mState = 1;
+    mExpired = 0;
+    mRevoked = 0;
+}
+
+void KeyringGenerator::setKeyCount(int count)
+{
+    mKeyCount = count;
+}
+
+void KeyringGenerator::setMaxUids(int count)
+{
+    mMaxUids = qMax(1, count);
+}
+
+void KeyringGenerator::setExpiredPercent(int percent)
+{
+    mExpiredPercent = percent;
+}
+
+void KeyringGenerator::setRevokedPercent(int percent)
+{
+    mRevokedPercent = percent;
+}
+
+void KeyringGenerator::setSeed(quint32 seed)
+{
+    mSeed = seed;
+}
+
+int KeyringGenerator::expiredCount() const
+{
+    return mExpired;
+}
+
+int KeyringGenerator::revokedCount() const
+{
+    return mRevoked;
+}
+
+/** xorshift, the same numbers on every platform unlike qrand()
+ */
+quint32 KeyringGenerator::random()
+{
+    mState ^= mState << 13;
+    mState ^= mState >> 17;
+    mState ^= mState << 5;
+    return mState;
+}
+
+bool KeyringGenerator::write(QIODevice *out)
+{
+    mState = mSeed * 2654435761u + 1;
+    if (mState == 0) {
+        mState = 1;
+    }
+    mExpired = 0;
+    mRevoked = 0;
+    for (int i = 0; i < mKeyCount; i++) {
+        if (out->write(key(i)) < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool KeyringGenerator::writeKeyDB(const QString &dir)
+{
+    if (!QDir().mkpath(dir)) {
+        return false;
+    }
+    QFile pubring(dir + "/pubring.gpg");
+    if (!pubring.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    return write(&pubring);
+}
+
+/** Key block of key index: the key packet, a revocation
+ *  if revoked, and the user ids with their self signatures
+ */
+QByteArray KeyringGenerator::key(int index)
+{
+    static const RsaKey rsa;
+
+    quint32 created = firstCreationTime + (quint32)index * 60;
+    QByteArray keyBody;
+    keyBody.append((char)4);
+    appendUInt32(&keyBody, created);
+    keyBody.append((char)1); // RSA
+    appendMpi(&keyBody, rsa.modulus());
+    appendMpi(&keyBody, uint32Bytes(publicExponent));
+
+    // v4 fingerprint, the key id are its last 8 bytes
+    QByteArray hashedKey;
+    hashedKey.append((char)0x99);
+    appendUInt16(&hashedKey, keyBody.size());
+    hashedKey.append(keyBody);
+    QByteArray keyId = QCryptographicHash::hash(hashedKey, QCryptographicHash::Sha1).right(8);
+
+    // a key is revoked or expired, gpg reports only the revocation of both
+    bool revoked = (int)(random() % 100) < mRevokedPercent;
+    bool expired = !revoked && (int)(random() % 100) < mExpiredPercent;
+    int uids = 1 + random() % mMaxUids;
+    QByteArray signatureTime = uint32Bytes(created + 1);
+
+    QByteArray block = packet(6, keyBody);
+    if (revoked) {
+        QByteArray hashed = subpacket(2, signatureTime) + subpacket(29, QByteArray(1, '\0'));
+        block.append(signature(rsa, keyId, 0x20, hashed, hashedKey));
+        mRevoked++;
+    }
+    if (expired) {
+        mExpired++;
+    }
+
+    for (int u = 0; u < uids; u++) {
+        QString first = firstNames[random() % (sizeof(firstNames) / sizeof(firstNames[0]))];
+        QString last = lastNames[random() % (sizeof(lastNames) / sizeof(lastNames[0]))];
+        QByteArray uid = QString("%1 %2 <%3.%4.%5@example%6.org>")
+                         .arg(first).arg(last).arg(first.toLower()).arg(last.toLower())
+                         .arg(index).arg(u).toUtf8();
+
+        // positive certification, usable for everything
+        QByteArray hashed = subpacket(2, signatureTime) + subpacket(27, QByteArray(1, '\x0f'));
+        if (expired) {
+            hashed += subpacket(9, uint32Bytes(expirationTime));
+        }
+        if (u == 0) {
+            hashed += subpacket(25, QByteArray(1, '\1'));
+        }
+        QByteArray hashedUid;
+        hashedUid.append((char)0xb4);
+        appendUInt32(&hashedUid, uid.size());
+        hashedUid.append(uid);
+
+        block.append(packet(13, uid));
+        block.append(signature(rsa, keyId, 0x13, hashed, hashedKey + hashedUid));
+    }
+    return block;
+}
@@ -0,0 +1,89 @@
+/*
+ *      keyringgenerator.h
+ *
+ *      Copyright 2008 gpg4usb-team <gpg4usb@cpunk.de>
+ *
+ *      This file is part of gpg4usb.
+ *
+ *      Gpg4usb is free software: you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation, either version 3 of the License, or
+ *      (at your option) any later version.
+ *
+ *      Gpg4usb is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with gpg4usb.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef __KEYRINGGENERATOR_H__
+#define __KEYRINGGENERATOR_H__
+
+#include <QIODevice>
+#include <QString>
+
+/**
+ * @brief Writes large binary keyrings for scale tests
+ *
+ * @details The keys are built packet by packet instead of running gpg, so
+ * 100k keys take a few minutes instead of hours. All keys share one 512 bit
+ * RSA key, they differ in the creation time and so in their fingerprints.
+ * User ids, self signatures and revocations are properly signed, gpg
+ * imports and lists the keys like real ones. The same seed gives the same
+ * keyring.
+ */
+class KeyringGenerator
+{
+public:
+    KeyringGenerator();
+
+    void setKeyCount(int count);
+    /**
+     * @details Every key gets between 1 and count user ids, default 3.
+     */
+    void setMaxUids(int count);
+    /**
+     * @details Share of the keys not revoked, which expired a year after
+     * their creation.
+     */
+    void setExpiredPercent(int percent);
+    /**
+     * @details Share of keys with a revocation signature.
+     */
+    void setRevokedPercent(int percent);
+    void setSeed(quint32 seed);
+
+    /**
+     * @details Write the keys to out as a binary keyring.
+     */
+    bool write(QIODevice *out);
+    /**
+     * @details Write the keys as pubring.gpg of the keydb dir, replacing
+     * its public keys. gpg reads it without an import.
+     */
+    bool writeKeyDB(const QString &dir);
+
+    /**
+     * @details Counts of the last write().
+     */
+    int expiredCount() const;
+    int revokedCount() const;
+
+private:
+    QByteArray key(int index);
+    quint32 random();
+
+    int mKeyCount;
+    int mMaxUids;
+    int mExpiredPercent;
+    int mRevokedPercent;
+    quint32 mSeed;
+    quint32 mState; /** of the random generator, reset by write() */
+    int mExpired;
+    int mRevoked;
+};
+
+#endif // __KEYRINGGENERATOR_H__
@@ -11,10 +11,26 @@ INCLUDEPATH += .
 
 # Input
 SOURCES += testgpgcontext.cpp \
+           keyringgenerator.cpp \
            ../gpgcontext.cpp \
-           ../gpgconstants.cpp
-HEADERS += ../gpgcontext.h \
-           ../gpgconstants.h
+           ../gpgconstants.cpp \
+           ../gpgjob.cpp \
+           ../gpgbatch.cpp \
+           ../gpgprocess.cpp \
+           ../gpgkeystore.cpp \
+           ../keylistmodel.cpp \
+           ../keysearchindex.cpp \
+           ../pgpkeyreader.cpp
+HEADERS += keyringgenerator.h \
+           ../gpgcontext.h \
+           ../gpgconstants.h \
+           ../gpgjob.h \
+           ../gpgbatch.h \
+           ../gpgprocess.h \
+           ../gpgkeystore.h \
+           ../keylistmodel.h \
+           ../keysearchindex.h \
+           ../pgpkeyreader.h
 
 LIBS += -lgpgme \
      -lgpg-error \
@@ -67,35 +67,40 @@ void TextEdit::slotOpen()
                                                           QDir::currentPath());
     foreach (QString fileName,fileNames){
         if (!fileName.isEmpty()) {
-            QFile file(fileName);
-
-            if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-                EditorPage *page = new EditorPage(fileName);
-
-                QTextStream in(&file);
-                QApplication::setOverrideCursor(Qt::WaitCursor);
-                page->getTextPage()->setPlainText(in.readAll());
-                page->setFilePath(fileName);
-                QTextDocument *document = page->getTextPage()->document();
-                document->setModified(false);
-
-                tabWidget->addTab(page, strippedName(fileName));
-                tabWidget->setCurrentIndex(tabWidget->count() - 1);
-                QApplication::restoreOverrideCursor();
-                page->getTextPage()->setFocus();
-                connect(page->getTextPage()->document(), SIGNAL(modificationChanged(bool)), this, SLOT(slotShowModified()));
-                //enableAction(true)
-                file.close();
-            } else {
-                QMessageBox::warning(this, tr("Application"),
-                                     tr("Cannot read file %1:\n%2.")
-                                     .arg(fileName)
-                                     .arg(file.errorString()));
-            }
+            openFile(fileName);
         }
     }
 }
 
+void TextEdit::openFile(const QString &fileName)
+{
+    QFile file(fileName);
+
+    if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        EditorPage *page = new EditorPage(fileName);
+
+        QTextStream in(&file);
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+        page->getTextPage()->setPlainText(in.readAll());
+        page->setFilePath(fileName);
+        QTextDocument *document = page->getTextPage()->document();
+        document->setModified(false);
+
+        tabWidget->addTab(page, strippedName(fileName));
+        tabWidget->setCurrentIndex(tabWidget->count() - 1);
+        QApplication::restoreOverrideCursor();
+        page->getTextPage()->setFocus();
+        connect(page->getTextPage()->document(), SIGNAL(modificationChanged(bool)), this, SLOT(slotShowModified()));
+        //enableAction(true)
+        file.close();
+    } else {
+        QMessageBox::warning(this, tr("Application"),
+                             tr("Cannot read file %1:\n%2.")
+                             .arg(fileName)
+                             .arg(file.errorString()));
+    }
+}
+
 void TextEdit::slotSave()
 {
     if (tabWidget->count() == 0 || slotCurPage() == 0) {
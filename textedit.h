@@ -62,6 +62,11 @@ public:
      */
     void loadFile(const QString &fileName);
 
+    /**
+     * @details Open file in a new tab and make it the current one.
+     */
+    void openFile(const QString &fileName);
+
 
     /**
      * @details Checks if there are unsaved documents in any tab,
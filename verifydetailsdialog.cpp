@@ -29,7 +29,8 @@ VerifyDetailsDialog::VerifyDetailsDialog(QWidget *parent, GpgME::GpgContext* ctx
     mTextpage = edit;
     this->setWindowTitle(tr("Signaturedetails"));
 
-    connect(mCtx, SIGNAL(keyDBChanged()), this, SLOT(slotRefresh()));
+    connect(mCtx, SIGNAL(signalKeyListRefreshed()), this, SLOT(slotRefresh()));
+    connect(mCtx, SIGNAL(signalKeysUpdated(QStringList)), this, SLOT(slotRefresh()));
     mainLayout = new QHBoxLayout();
     this->setLayout(mainLayout);
 
@@ -29,7 +29,8 @@ VerifyNotification::VerifyNotification(QWidget *parent, GpgME::GpgContext *ctx,
     mTextpage = edit;
     verifyLabel = new QLabel(this);
 
-    connect(mCtx, SIGNAL(keyDBChanged()), this, SLOT(slotRefresh()));
+    connect(mCtx, SIGNAL(signalKeyListRefreshed()), this, SLOT(slotRefresh()));
+    connect(mCtx, SIGNAL(signalKeysUpdated(QStringList)), this, SLOT(slotRefresh()));
     connect(edit, SIGNAL(textChanged()), this, SLOT(close()));
 
     importFromKeyserverAct = new QAction(tr("Import missing key from Keyserver"), this);
@@ -44,6 +45,8 @@ VerifyNotification::VerifyNotification(QWidget *parent, GpgME::GpgContext *ctx,
     importFromKeyserverAct->setVisible(false);
 
     keysNotInList = new QStringList();
+    mDecrypted = false;
+    mTextIsSigned = 0;
     detailsButton = new QPushButton(tr("Details"),this);
     detailsButton->setMenu(detailMenu);
     QHBoxLayout *notificationWidgetLayout = new QHBoxLayout(this);
@@ -92,11 +95,16 @@ void VerifyNotification::slotShowVerifyDetails()
 
 bool VerifyNotification::slotRefresh()
 {
-    verify_label_status verifyStatus=VERIFY_ERROR_OK;
+    // decrypted text carries no signature anymore, only the
+    // names of the signing keys can change
+    if (mDecrypted) {
+        updateLabel();
+        return true;
+    }
 
     QByteArray text = mTextpage->toPlainText().toUtf8();
     mCtx->preventNoDataErr(&text);
-    int textIsSigned = mCtx->textIsSigned(text);
+    mTextIsSigned = mCtx->textIsSigned(text);
 
     gpgme_signature_t sign = mCtx->verify(text);
 
@@ -104,24 +112,67 @@ bool VerifyNotification::slotRefresh()
         return false;
     }
 
+    copySignatures(sign);
+    updateLabel();
+    return true;
+}
+
+bool VerifyNotification::setDecryptedSignatures(const QStringList &fprs, const QList<gpgme_error_t> &status)
+{
+    if (fprs.isEmpty()) {
+        return false;
+    }
+
+    mDecrypted = true;
+    mTextIsSigned = 2;
+    // verify details are computed from the text, which is plain now
+    showVerifyDetailsAct->setVisible(false);
+
+    mSignatureFprs = fprs;
+    mSignatureStatus = status;
+    updateLabel();
+    return true;
+}
+
+/** Keep what is needed for the label, the gpgme
+ *  result is only valid till the next operation of the context
+ */
+void VerifyNotification::copySignatures(gpgme_signature_t sign)
+{
+    mSignatureFprs.clear();
+    mSignatureStatus.clear();
+    while (sign) {
+        mSignatureFprs << QString(sign->fpr);
+        mSignatureStatus << sign->status;
+        sign = sign->next;
+    }
+}
+
+void VerifyNotification::updateLabel()
+{
+    verify_label_status verifyStatus=VERIFY_ERROR_OK;
+    int textIsSigned = mTextIsSigned;
+
     QString verifyLabelText;
     bool unknownKeyFound=false;
+    keysNotInList->clear();
 
-    while (sign) {
+    for (int i = 0; i < mSignatureFprs.size(); i++) {
+        QString fpr = mSignatureFprs.at(i);
 
-        switch (gpg_err_code(sign->status))
+        switch (gpg_err_code(mSignatureStatus.at(i)))
         {
             case GPG_ERR_NO_PUBKEY:
             {
                 verifyStatus=VERIFY_ERROR_WARN;
-                verifyLabelText.append(tr("Key not present with id 0x")+QString(sign->fpr));
-                this->keysNotInList->append(sign->fpr);
+                verifyLabelText.append(tr("Key not present with id 0x")+fpr);
+                this->keysNotInList->append(fpr);
                 unknownKeyFound=true;
                 break;
             }
             case GPG_ERR_NO_ERROR:
             {
-                GpgKey key = mCtx->getKeyByFpr(sign->fpr);
+                GpgKey key = mCtx->getKeyByFpr(fpr);
                 verifyLabelText.append(key.name);
                 if (!key.email.isEmpty()) {
                     verifyLabelText.append("<"+key.email+">");
@@ -132,7 +183,7 @@ bool VerifyNotification::slotRefresh()
             {
                 textIsSigned = 3;
                 verifyStatus=VERIFY_ERROR_CRITICAL;
-                GpgKey key = mCtx->getKeyById(sign->fpr);
+                GpgKey key = mCtx->getKeyById(fpr);
                 verifyLabelText.append(key.name);
                 if (!key.email.isEmpty()) {
                     verifyLabelText.append("<"+key.email+">");
@@ -144,12 +195,11 @@ bool VerifyNotification::slotRefresh()
                 //textIsSigned = 3;
                 verifyStatus=VERIFY_ERROR_WARN;
                 //GpgKey key = mKeyList->getKeyByFpr(sign->fpr);
-                verifyLabelText.append(tr("Error for key with fingerprint ")+mCtx->beautifyFingerprint(QString(sign->fpr)));
+                verifyLabelText.append(tr("Error for key with fingerprint ")+mCtx->beautifyFingerprint(fpr));
                 break;
             }
         }
         verifyLabelText.append("\n");
-        sign = sign->next;
     }
 
     switch (textIsSigned)
@@ -161,7 +211,11 @@ bool VerifyNotification::slotRefresh()
             }
         case 2:
             {
-                verifyLabelText.prepend(tr("Text was completely signed by: "));
+                if (mDecrypted) {
+                    verifyLabelText.prepend(tr("Decrypted text was signed by: "));
+                } else {
+                    verifyLabelText.prepend(tr("Text was completely signed by: "));
+                }
                 break;
             }
         case 1:
@@ -178,6 +232,4 @@ bool VerifyNotification::slotRefresh()
     verifyLabelText.remove(verifyLabelText.length()-1,1);
 
     this->setVerifyLabel(verifyLabelText,verifyStatus);
-
-    return true;
 }
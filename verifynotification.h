@@ -73,6 +73,16 @@ public:
      */
     void showImportAction(bool visible);
 
+    /**
+     * @details Show the signatures found by a GpgJob::DecryptVerify job for
+     * the decrypted text of the page, instead of verifying the text.
+     *
+     * @param fprs Fingerprints or key ids of the signatures
+     * @param status Status of the signatures, in the same order
+     * @return false, if there are no signatures
+     */
+    bool setDecryptedSignatures(const QStringList &fprs, const QList<gpgme_error_t> &status);
+
     QStringList *keysNotInList; /** List with keys, which are in signature but not in keylist */
 
 
@@ -94,6 +104,9 @@ public slots:
     bool slotRefresh();
 
 private:
+    void copySignatures(gpgme_signature_t sign);
+    void updateLabel();
+
     QMenu *detailMenu; /** Menu for te Button in verfiyNotification */
     QAction *importFromKeyserverAct; /** Action for importing keys from keyserver which are notin keylist */
     QAction *showVerifyDetailsAct; /** Action for showing verify detail dialog */
@@ -104,6 +117,10 @@ private:
     QTextEdit *mTextpage; /** Textedit associated to the notification */
     QVector<QString> verifyDetailStringVector; /** Vector containing the text for labels in verifydetaildialog */
     QVector<verify_label_status> verifyDetailStatusVector; /** Vector containing the status for labels in verifydetaildialog */
+    QStringList mSignatureFprs; /** fingerprints or key ids of the signatures */
+    QList<gpgme_error_t> mSignatureStatus; /** status of the signatures */
+    int mTextIsSigned; /** result of GpgContext::textIsSigned, 3 for a bad signature */
+    bool mDecrypted; /** signatures came from decryption, the text isn't signed itself */
 
 };
 #endif // __VERIFYNOTIFICATION_H__
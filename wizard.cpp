@@ -78,30 +78,16 @@ bool Wizard::importPubAndSecKeysFromDir(const QString dir, KeyMgmt *keyMgmt)
         return false;
     }
 
-    QByteArray inBuffer;
+    // secret keys first, the public keys complete them. The files are
+    // streamed, a keyring may be larger than the memory
+    QStringList fileNames;
     if (secRingFile.exists()) {
-        // write content of secringfile to inBuffer
-        if (!secRingFile.open(QIODevice::ReadOnly)) {
-            QMessageBox::critical(0, tr("Import error"), tr("Couldn't open private keyringfile: %1").arg(secRingFile.fileName()));
-            return false;
-        }
-        inBuffer = secRingFile.readAll();
-        secRingFile.close();
+        fileNames << secRingFile.fileName();
     }
-
     if (pubRingFile.exists()) {
-        // try to import public keys
-        if (!pubRingFile.open(QIODevice::ReadOnly)) {
-            QMessageBox::critical(0, tr("Import error"), tr("Couldn't open public keyringfile: %1").arg(pubRingFile.fileName()));
-            return false;
-        }
-        inBuffer.append(pubRingFile.readAll());
-        pubRingFile.close();
+        fileNames << pubRingFile.fileName();
     }
-    keyMgmt->slotImportKeys(inBuffer);
-    inBuffer.clear();
-
-    return true;
+    return keyMgmt->importKeyFiles(fileNames);
 }
 
 IntroPage::IntroPage(QWidget *parent)